@@ -5,13 +5,21 @@
 // the Free Software Foundation; either version 2 of the License, or
 // (at your option) any later version.
 
+#include <deque>
 #include <memory>
+#include <string>
+#include <ctype.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <io.h>
 #include <fcntl.h>
+#include <process.h>
 #include "internal.h"
+#include "output.h"
+#include "jobs.h"
+#include "bench.h"
+#include "host.h"
 
 #ifdef _MSC_VER
 // what's up with MS's std libs?
@@ -28,24 +36,188 @@
 #define INT_MAX 0x7fffffff
 #endif
 
-#define MY_VERSION "Avs2YUV 0.24"
-#define MAX_FH 10
+#define MY_VERSION "Avs2YUV 0.33"
+#define MAX_QUEUE 64
+
+// Bounded single-producer/single-consumer queue between the render loop and
+// a writer thread, so GetFrame() for the next frames runs while the previous
+// ones are still being written. Slots are only reassigned by the producer,
+// which keeps all PVideoFrame releases on the rendering thread.
+class FrameQueue {
+    Outputs&    out;
+    PVideoFrame slots[MAX_QUEUE];
+    int         frames[MAX_QUEUE];
+    int         size;
+    int         head;
+    int         tail;
+    HANDLE      free_slots;
+    HANDLE      used_slots;
+    HANDLE      thread;
+    volatile bool failed;
+
+    static unsigned __stdcall writer(void* arg) {
+        FrameQueue* q = (FrameQueue*)arg;
+        for (;;) {
+            WaitForSingleObject(q->used_slots, INFINITE);
+            const PVideoFrame& f = q->slots[q->head];
+            if (!f)
+                break;
+            if (!q->failed && !write_frame(f, q->frames[q->head], q->out))
+                q->failed = true;
+            q->head = (q->head + 1) % q->size;
+            ReleaseSemaphore(q->free_slots, 1, NULL);
+        }
+        return 0;
+    }
+
+public:
+    FrameQueue(Outputs& _out, int _size) : out(_out), size(_size), head(0), tail(0), failed(false) {
+        // one extra slot for the end-of-stream marker
+        size = min(max(size, 1), MAX_QUEUE-1) + 1;
+        free_slots = CreateSemaphore(NULL, size-1, size, NULL);
+        used_slots = CreateSemaphore(NULL, 0, size, NULL);
+        unsigned tid;
+        thread = (HANDLE)_beginthreadex(0, 0, &writer, this, 0, &tid);
+    }
+
+    ~FrameQueue() {
+        finish();
+        CloseHandle(free_slots);
+        CloseHandle(used_slots);
+    }
+
+    // returns false once the writer has hit an output error
+    bool push(const PVideoFrame& f, int frm) {
+        WaitForSingleObject(free_slots, INFINITE);
+        slots[tail] = f;
+        frames[tail] = frm;
+        tail = (tail + 1) % size;
+        ReleaseSemaphore(used_slots, 1, NULL);
+        return !failed;
+    }
+
+    // drains the queue and stops the writer thread
+    bool finish() {
+        if (thread) {
+            slots[tail] = PVideoFrame();
+            ReleaseSemaphore(used_slots, 1, NULL);
+            WaitForSingleObject(thread, INFINITE);
+            CloseHandle(thread);
+            thread = NULL;
+            for (int i = 0; i < size; i++)
+                slots[i] = PVideoFrame();
+        }
+        return !failed;
+    }
+};
+
+// frames still to be rendered from one slave command, first to last inclusive
+struct FrameRange {
+    int         next;
+    int         last;
+};
+
+static bool read_line(FILE* f, std::string& line) {
+    line.clear();
+    int c;
+    while ((c = getc(f)) != EOF && c != '\n')
+        line += (char)c;
+    return c != EOF || !line.empty();
+}
+
+// Parses one line of slave input: frame numbers and first-last ranges (which
+// may count down) separated by commas or whitespace. Anything else, including
+// negative numbers, is ignored. Frames past the end are clamped to the last.
+static void parse_frame_list(const std::string& line, int num_frames, std::deque<FrameRange>& pending) {
+    const char* p = line.c_str();
+    while (*p) {
+        while (*p == ',' || isspace((unsigned char)*p))
+            p++;
+        if (!*p)
+            break;
+        char* e;
+        FrameRange r;
+        bool ok = isdigit((unsigned char)*p) != 0;
+        r.next = r.last = (int)strtol(p, &e, 10);
+        if (ok && *e == '-' && isdigit((unsigned char)e[1]))
+            r.last = (int)strtol(e + 1, &e, 10);
+        if (*e && *e != ',' && !isspace((unsigned char)*e))
+            ok = false;
+        // skip to the next separator
+        for (p = e; *p && *p != ',' && !isspace((unsigned char)*p); p++);
+        if (!ok)
+            continue;
+        r.next = min(r.next, num_frames-1);
+        r.last = min(r.last, num_frames-1);
+        pending.push_back(r);
+    }
+}
+
+// Imports the script into env and converts it to YV12, unless it's YUY2 and
+// keep_yuy2 is set. Errors are reported here, and leave the returned clip empty.
+static PClip import_script(IScriptEnvironment* env, const char* infile, bool keep_yuy2, bool print_info) {
+    AVSValue arg(infile);
+    AVSValue res = env->Invoke("Import", AVSValue(&arg, 1));
+    if (!res.IsClip()) {
+        fprintf_s(stderr, "Error: '%s' didn't return a video clip.\n", infile);
+        return PClip();
+    }
+    PClip clip = res.AsClip();
+    VideoInfo inf = clip->GetVideoInfo();
+
+    if (print_info) {
+        fprintf_s(stderr, "%s: %dx%d, ", infile, inf.width, inf.height);
+        if (inf.fps_denominator == 1)
+            fprintf_s(stderr, "%u fps, ", inf.fps_numerator);
+        else
+            fprintf_s(stderr, "%u/%u fps, ", inf.fps_numerator, inf.fps_denominator);
+        fprintf_s(stderr, "%d frames\n", inf.num_frames);
+    }
+
+    if (!inf.IsYV12() && !(keep_yuy2 && inf.IsYUY2())) {
+        if (!env->FunctionExists("converttoyv12")) {
+            fprintf_s(stderr, "%s input needs converting to YV12, which this host can't do\n", inf.IsYUY2() ? "YUY2" : "RGB");
+            return PClip();
+        }
+        if (print_info)
+            fprintf_s(stderr, "converting %s -> YV12\n", inf.IsYUY2() ? "YUY2" : inf.IsRGB() ? "RGB" : "?");
+        res = env->Invoke("converttoyv12", AVSValue(&res, 1));
+        clip = res.AsClip();
+        inf = clip->GetVideoInfo();
+    }
+    if (!inf.IsYV12() && !inf.IsYUY2()) {
+        fprintf_s(stderr, "Couldn't convert input to YV12\n");
+        return PClip();
+    }
+    if (inf.IsFieldBased()) {
+        fprintf_s(stderr, "Needs progressive input\n");
+        return PClip();
+    }
+    return clip;
+}
 
 int __cdecl main(int argc, const char* argv[]) {
     const char* infile                 = nullptr;
     const char* hfyufile               = nullptr;
     const char* outfile[MAX_FH];
-    int         y4m_headers[MAX_FH];
-    FILE*       out_fh[10];
-    int         out_fhs                = 0;
+    Outputs     out                    = {};
     bool        verbose                = 0;
     bool        usage                  = 0;
     int         seek                   = 0;
     int         end                    = 0;
     int         slave                  = 0;
     int         rawyuv                 = 0;
+    int         queue_len              = 0;
+    int         num_jobs               = 1;
+    int         chunk                  = 0;
+    bool        bench                  = 0;
+    bool        json                   = 0;
+    int         warmup                 = 5;
+    const char* hashfile               = nullptr;
+    bool        keep_422               = 0;
+    bool        native                 = 0;
+    std::vector<const char*> plugins;
     int         frm                    = -1;
-    int         write_target           = 0; // how many bytes per frame we expect to write
 
     for (int i = 1; i < argc; i++) {
         if (argv[i][0] == '-' && argv[i][1] != 0) {
@@ -79,10 +251,59 @@ int __cdecl main(int argc, const char* argv[]) {
                     return 2;
                 }
                 hfyufile = argv[++i];
+            } else if (!strcmp(argv[i], "-hash")) {
+                if (i > argc-2) {
+                    fprintf_s(stderr, "-hash needs an argument\n");
+                    return 2;
+                }
+                hashfile = argv[++i];
             } else if (!strcmp(argv[i], "-raw")) {
                 rawyuv = 1;
             } else if (!strcmp(argv[i], "-slave")) {
                 slave = 1;
+            } else if (!strcmp(argv[i], "-422")) {
+                keep_422 = true;
+            } else if (!strcmp(argv[i], "-native")) {
+                native = true;
+            } else if (!strcmp(argv[i], "-plugin")) {
+                if (i > argc-2) {
+                    fprintf_s(stderr, "-plugin needs an argument\n");
+                    return 2;
+                }
+                plugins.push_back(argv[++i]);
+                native = true;
+            } else if (!strcmp(argv[i], "-queue")) {
+                if (i > argc-2) {
+                    fprintf_s(stderr, "-queue needs an argument\n");
+                    return 2;
+                }
+                queue_len = atoi(argv[++i]);
+                if (queue_len < 0 || queue_len > MAX_QUEUE-1) usage = 1;
+            } else if (!strcmp(argv[i], "-jobs")) {
+                if (i > argc-2) {
+                    fprintf_s(stderr, "-jobs needs an argument\n");
+                    return 2;
+                }
+                num_jobs = atoi(argv[++i]);
+                if (num_jobs < 1 || num_jobs > MAX_JOBS) usage = 1;
+            } else if (!strcmp(argv[i], "-chunk")) {
+                if (i > argc-2) {
+                    fprintf_s(stderr, "-chunk needs an argument\n");
+                    return 2;
+                }
+                chunk = atoi(argv[++i]);
+                if (chunk < 1) usage = 1;
+            } else if (!strcmp(argv[i], "-bench")) {
+                bench = true;
+            } else if (!strcmp(argv[i], "-json")) {
+                json = true;
+            } else if (!strcmp(argv[i], "-warmup")) {
+                if (i > argc-2) {
+                    fprintf_s(stderr, "-warmup needs an argument\n");
+                    return 2;
+                }
+                warmup = atoi(argv[++i]);
+                if (warmup < 0) usage = 1;
             } else {
                 fprintf_s(stderr, "no such option: %s\n", argv[i]);
                 return 2;
@@ -95,24 +316,46 @@ int __cdecl main(int argc, const char* argv[]) {
 			}
         } else {
 add_outfile:
-            if (out_fhs > MAX_FH-1) {
+            if (out.count > MAX_FH-1) {
                 fprintf_s(stderr, "too many output files\n");
                 return 2;
             }
-            outfile[out_fhs] = argv[i];
-            y4m_headers[out_fhs] = !rawyuv;
-            out_fhs++;
+            outfile[out.count] = argv[i];
+            out.y4m_headers[out.count] = !rawyuv;
+            out.count++;
         }
     }
 
-    if (usage || !infile || (!out_fhs && !hfyufile && !verbose)) {
+    if (slave && num_jobs > 1) {
+        fprintf_s(stderr, "-jobs can't be combined with -slave\n");
+        return 2;
+    }
+
+    if (bench && (out.count || hfyufile || hashfile || slave || num_jobs > 1)) {
+        fprintf_s(stderr, "-bench doesn't write output and can't be combined with -slave or -jobs\n");
+        return 2;
+    }
+
+    if (usage || !infile || (!out.count && !hfyufile && !hashfile && !verbose && !bench)) {
         fprintf_s(stderr, MY_VERSION "\n"
                   "Usage: avs2yuv [options] in.avs [-o out.y4m] [-o out2.y4m] [-hfyu out.avi]\n"
                   "-v\tprint the frame number after processing each frame\n"
                   "-seek\tseek to the given frame number\n"
                   "-frames\tstop after processing this many frames\n"
-                  "-slave\tread a list of frame numbers from stdin (one per line)\n"
-                  "-raw\toutputs raw I420 instead of yuv4mpeg\n"
+                  "-slave\tread frame numbers from stdin, one command per line;\n"
+                  "\ta command may list several frames and ranges, e.g. \"0 5,7 120-180\"\n"
+                  "-hash\twrite per-plane xxh64 checksums of each frame to this file\n"
+                  "-raw\toutputs raw I420 (I422 with -422) instead of yuv4mpeg\n"
+                  "-422\twrite YUY2 input as planar 4:2:2 instead of converting it to YV12\n"
+                  "-queue\trender up to this many frames ahead of the output writer thread\n"
+                  "-jobs\trender with this many copies of the script, each on its own thread\n"
+                  "-chunk\tnumber of consecutive frames each job renders at a time (default 300,\n"
+                  "\tor less to keep the buffered frames under 512 MB when writing to a pipe)\n"
+                  "-bench\trender without writing and report timings instead\n"
+                  "-warmup\tframes -bench leaves out of the statistics (default 5)\n"
+                  "-json\tprint the -bench report to stdout as JSON\n"
+                  "-native\trun the script without avisynth.dll: plugins and plain filter chains only\n"
+                  "-plugin\tload this plugin before the script (may be repeated); implies -native\n"
                   "The outfile may be \"-\", meaning stdout.\n"
                   "Output format is yuv4mpeg, as used by MPlayer and mjpegtools\n"
                   "Huffyuv output requires MEncoder, and probably doesn't work in Wine.\n"
@@ -121,64 +364,46 @@ add_outfile:
     }
 
     try {
-        HMODULE avsdll = LoadLibrary("avisynth.dll");
-        if (!avsdll) {
-            fprintf_s(stderr, "failed to load avisynth.dll\n");
+        std::unique_ptr<Host> host(native ? create_native_host(plugins) : create_avisynth_host());
+        if (!host)
             return 2;
-        }
-        IScriptEnvironment* (* CreateScriptEnvironment)(int version)
-        = (IScriptEnvironment*(*)(int)) GetProcAddress(avsdll, "CreateScriptEnvironment");
-        if (!CreateScriptEnvironment) {
-            fprintf_s(stderr, "failed to load CreateScriptEnvironment()\n");
+        std::shared_ptr<IScriptEnvironment> pEnv(host->create_env());
+        if (!pEnv)
             return 1;
-        }
-
-        IScriptEnvironment* env = CreateScriptEnvironment(AVISYNTH_INTERFACE_VERSION);
-        std::shared_ptr<IScriptEnvironment> pEnv(env);
-        AVSValue arg(infile);
-        AVSValue res = pEnv->Invoke("Import", AVSValue(&arg, 1));
-        if (!res.IsClip()) {
-            fprintf_s(stderr, "Error: '%s' didn't return a video clip.\n", infile);
+        PClip clip = import_script(pEnv.get(), infile, keep_422, true);
+        if (!clip)
             return 1;
-        }
-        PClip clip = res.AsClip();
         VideoInfo inf = clip->GetVideoInfo();
 
-        fprintf_s(stderr, "%s: %dx%d, ", infile, inf.width, inf.height);
-        if (inf.fps_denominator == 1)
-            fprintf_s(stderr, "%u fps, ", inf.fps_numerator);
-        else
-            fprintf_s(stderr, "%u/%u fps, ", inf.fps_numerator, inf.fps_denominator);
-        fprintf_s(stderr, "%d frames\n", inf.num_frames);
-
-        if (!inf.IsYV12()) {
-            fprintf_s(stderr, "converting %s -> YV12\n", inf.IsYUY2() ? "YUY2" : inf.IsRGB() ? "RGB" : "?");
-            res = pEnv->Invoke("converttoyv12", AVSValue(&res, 1));
-            clip = res.AsClip();
-            inf = clip->GetVideoInfo();
-        }
-        if (!inf.IsYV12()) {
-            fprintf_s(stderr, "Couldn't convert input to YV12\n");
-            return 1;
-        }
-        if (inf.IsFieldBased()) {
-            fprintf_s(stderr, "Needs progressive input\n");
-            return 1;
+        // declared after pEnv so that the extra environments go away first
+        std::vector<Job> jobs;
+        if (num_jobs > 1) {
+            jobs.resize(num_jobs);
+            jobs[0].env = pEnv;
+            jobs[0].clip = clip;
+            for (int j = 1; j < num_jobs; j++) {
+                jobs[j].env.reset(host->create_env());
+                if (!jobs[j].env)
+                    return 1;
+                jobs[j].clip = import_script(jobs[j].env.get(), infile, keep_422, false);
+                if (!jobs[j].clip)
+                    return 1;
+            }
         }
 
-        for (int i = 0; i < out_fhs; i++) {
+        for (int i = 0; i < out.count; i++) {
             if (!strcmp(outfile[i], "-")) {
                 for (int j=0; j<i; j++)
-                    if (out_fh[j] == stdout) {
+                    if (out.fh[j] == stdout) {
                         fprintf_s(stderr, "can't write to stdout multiple times\n");
                         return 2;
                     }
                 int dupout = dup(_fileno(stdout));
                 fclose(stdout);
                 setmode(dupout, O_BINARY);
-                out_fh[i] = fdopen(dupout, "wb");
+                out.fh[i] = fdopen(dupout, "wb");
             } else {
-                errno_t err = fopen_s(&out_fh[i], outfile[i], "wb");
+                errno_t err = fopen_s(&out.fh[i], outfile[i], "wb");
                 if (err != 0) {
                     fprintf_s(stderr, "fopen(\"%s\") failed", outfile);
                     return 1;
@@ -188,26 +413,61 @@ add_outfile:
         if (hfyufile) {
             char *cmd = new char[100+strlen(hfyufile)];
             sprintf_s(cmd, sizeof(cmd), "mencoder - -o \"%s\" -quiet -ovc lavc -lavcopts vcodec=ffvhuff:vstrict=-1:pred=2:context=1", hfyufile);
-            out_fh[out_fhs] = popen(cmd, "wb");
-            if (!out_fh[out_fhs]) {
+            out.fh[out.count] = popen(cmd, "wb");
+            if (!out.fh[out.count]) {
                 fprintf_s(stderr, "failed to exec mencoder\n");
                 return 1;
             }
-            y4m_headers[out_fhs] = 1;
-            out_fhs++;
+            out.y4m_headers[out.count] = 1;
+            out.count++;
             delete [] cmd;
         }
+        if (hashfile) {
+            if (!strcmp(hashfile, "-")) {
+                for (int i = 0; i < out.count; i++)
+                    if (!strcmp(outfile[i], "-")) {
+                        fprintf_s(stderr, "can't write to stdout multiple times\n");
+                        return 2;
+                    }
+                out.hash_fh = stdout;
+            } else if (fopen_s(&out.hash_fh, hashfile, "w") != 0) {
+                fprintf_s(stderr, "fopen(\"%s\") failed\n", hashfile);
+                return 1;
+            }
+            fprintf_s(out.hash_fh, "# frame xxh64(Y) xxh64(U) xxh64(V), %dx%d %s\n",
+                      inf.width, inf.height, inf.IsYUY2() ? "4:2:2" : "4:2:0");
+        }
 
-        for (int i = 0; i < out_fhs; i++) {
-            if (!y4m_headers[i])
+        for (int i = 0; i < out.count; i++) {
+            if (!out.y4m_headers[i])
                 continue;
-            fprintf_s(out_fh[i], "YUV4MPEG2 W%d H%d F%lu:%lu Ip A0:0\n",
-                      inf.width, inf.height, inf.fps_numerator, inf.fps_denominator);
-            fflush(out_fh[i]);
+            fprintf_s(out.fh[i], "YUV4MPEG2 W%d H%d F%lu:%lu Ip A0:0%s\n",
+                      inf.width, inf.height, inf.fps_numerator, inf.fps_denominator,
+                      inf.IsYUY2() ? " C422" : "");
+            fflush(out.fh[i]);
         }
 
-        write_target = out_fhs*inf.width*inf.height*3/2;
+        init_outputs(out, inf);
+        // declared before the queue so that it sees the frames the queue
+        // still writes when it's torn down
+        TrimOutputs trim(out);
+        // declared after pEnv so that it's drained before the environment goes away
+        std::unique_ptr<FrameQueue> queue;
+        if (queue_len && any_outputs(out) && jobs.empty())
+            queue.reset(new FrameQueue(out, queue_len));
+        // -bench packs every frame into a scratch buffer, which is the
+        // output work minus the actual I/O
+        std::unique_ptr<Bench> timings;
+        std::vector<BYTE> scratch;
+        if (bench) {
+            timings.reset(new Bench(warmup));
+            scratch.resize(out.frame_size);
+        }
 
+        // slave commands not rendered yet; with -queue these are rendered
+        // ahead of the writer
+        std::deque<FrameRange> pending;
+        std::string input;
         if (slave) {
             seek = 0;
             end = INT_MAX;
@@ -217,54 +477,59 @@ add_outfile:
                 end = inf.num_frames;
         }
 
+        // with the length known, files get their space reserved up front,
+        // which also lets -jobs write frames into place out of order
+        bool positional = !slave && preallocate_outputs(out, end - seek);
+
+        if (!jobs.empty()) {
+            bool in_place = positional && !out.hash_fh;
+            if (!chunk)
+                chunk = default_chunk(num_jobs, out, in_place);
+            if (render_jobs(jobs, seek, end, chunk, out, in_place, verbose))
+                return 1;
+            goto end_of_input;
+        }
+
         for (frm = seek; frm < end; ++frm) {
             if (slave) {
-                char input[80];
-                frm = -1;
-                do {
-                    if (!fgets(input, 80, stdin))
-                        goto close_files;
-                    sscanf_s(input, "%d", &frm);
-                } while (frm < 0);
-                if (frm >= inf.num_frames)
-                    frm = inf.num_frames-1;
+                while (pending.empty()) {
+                    if (!read_line(stdin, input))
+                        goto end_of_input;
+                    parse_frame_list(input, inf.num_frames, pending);
+                }
+                FrameRange& r = pending.front();
+                frm = r.next;
+                if (r.next == r.last)
+                    pending.pop_front();
+                else
+                    r.next += r.next < r.last ? 1 : -1;
             }
 
+            double start = timings ? Bench::now() : 0;
             PVideoFrame f = clip->GetFrame(frm, pEnv.get());
 
-            if (out_fhs) {
-                static const int planes[] = {PLANAR_Y, PLANAR_U, PLANAR_V};
-                int wrote = 0;
-
-                for (int i = 0; i < out_fhs; i++)
-                    if (y4m_headers[i])
-                        fwrite("FRAME\n", 1, 6, out_fh[i]);
-
-                for (int p = 0; p < 3; p++) {
-                    int w = inf.width  >> (p ? 1 : 0);
-                    int h = inf.height >> (p ? 1 : 0);
-                    int pitch = f->GetPitch(planes[p]);
-                    const BYTE* data = f->GetReadPtr(planes[p]);
-                    int y;
-                    for (y = 0; y < h; y++) {
-                        for (int i = 0; i < out_fhs; i++)
-                            wrote += fwrite(data, 1, w, out_fh[i]);
-                        data += pitch;
-                    }
-                }
-                if (wrote != write_target) {
-                    fprintf_s(stderr, "Output error: wrote only %d of %d bytes\n", wrote, write_target);
+            if (timings) {
+                double rendered = Bench::now();
+                pack_frame(f, out, &scratch[0]);
+                timings->add(start, rendered, Bench::now());
+            }
+
+            if (any_outputs(out)) {
+                if (queue) {
+                    if (!queue->push(f, frm))
+                        return 1;
+                } else if (!write_frame(f, frm, out))
                     return 1;
-                }
-                if (slave) { // assume timing doesn't matter in other modes
-                    for (int i = 0; i < out_fhs; i++)
-                        fflush(out_fh[i]);
-                }
             }
 
             if (verbose)
                 fprintf_s(stderr, "%d\n", frm);
         }
+end_of_input:
+        if (queue && !queue->finish())
+            return 1;
+        if (timings)
+            timings->report(json ? stdout : stderr, json);
     } catch (AvisynthError err) {
         if (frm >= 0)
             fprintf_s(stderr, "\nAvisynth error at frame %d:\n%s\n", frm, err.msg);
@@ -273,12 +538,14 @@ add_outfile:
         return 1;
     }
 
-close_files:
     if (hfyufile) {
-        pclose(out_fh[out_fhs-1]);
-        out_fhs--;
+        pclose(out.fh[out.count-1]);
+        out.count--;
     }
-    for (int i = 0; i < out_fhs; i++)
-        fclose(out_fh[i]);
+    for (int i = 0; i < out.count; i++)
+        fclose(out.fh[i]);
+    if (out.hash_fh && out.hash_fh != stdout)
+        fclose(out.hash_fh);
+    free_outputs(out);
     return 0;
 }
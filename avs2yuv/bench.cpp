@@ -0,0 +1,131 @@
+// Avs2YUV by Loren Merritt
+
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+
+#include <algorithm>
+#include "internal.h"
+#include "bench.h"
+
+#ifdef _WIN32
+#include <psapi.h>
+#else
+#include <time.h>
+#include <sys/resource.h>
+#endif
+
+#define HIST_BUCKETS 16
+
+Bench::Bench(int _warmup) : warmup(_warmup), seen(0), first_start(0), last_done(0) {}
+
+double Bench::now() {
+#ifdef _WIN32
+    LARGE_INTEGER freq, t;
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&t);
+    return t.QuadPart * 1000.0 / freq.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+#endif
+}
+
+void Bench::add(double start, double rendered, double done) {
+    if (seen++ < warmup)
+        return;
+    if (render_ms.empty())
+        first_start = start;
+    last_done = done;
+    render_ms.push_back(rendered - start);
+    output_ms.push_back(done - rendered);
+}
+
+static double peak_rss_mb() {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS pmc;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc)))
+        return 0;
+    return pmc.PeakWorkingSetSize / (1024.0*1024.0);
+#else
+    struct rusage ru;
+    if (getrusage(RUSAGE_SELF, &ru))
+        return 0;
+    return ru.ru_maxrss / 1024.0;
+#endif
+}
+
+// nearest-rank percentile of an already sorted list
+static double percentile(const std::vector<double>& sorted, int pct) {
+    if (sorted.empty())
+        return 0;
+    size_t rank = (sorted.size() * pct + 99) / 100;
+    return sorted[max(rank, (size_t)1) - 1];
+}
+
+static double sum(const std::vector<double>& v) {
+    double s = 0;
+    for (size_t i = 0; i < v.size(); i++)
+        s += v[i];
+    return s;
+}
+
+void Bench::report(FILE* f, bool json) const {
+    int frames = (int)render_ms.size();
+    std::vector<double> sorted(render_ms);
+    std::sort(sorted.begin(), sorted.end());
+
+    double wall = last_done - first_start;
+    double fps = wall > 0 ? frames * 1000.0 / wall : 0;
+    double render = sum(render_ms);
+    double output = sum(output_ms);
+    double total = render + output;
+
+    // GetFrame() latency in power-of-two buckets: <1ms, 1-2ms, 2-4ms, ...
+    int hist[HIST_BUCKETS] = {};
+    for (int i = 0; i < frames; i++) {
+        int b = 0;
+        for (double ms = render_ms[i]; ms >= 1.0 && b < HIST_BUCKETS-1; ms /= 2)
+            b++;
+        hist[b]++;
+    }
+    int buckets = HIST_BUCKETS;
+    while (buckets > 1 && !hist[buckets-1])
+        buckets--;
+
+    if (json) {
+        fprintf(f, "{\"frames\":%d,\"warmup\":%d,\"fps\":%.3f,\"wall_ms\":%.3f,", frames, warmup, fps, wall);
+        fprintf(f, "\"getframe_ms\":{\"mean\":%.4f,\"p50\":%.4f,\"p95\":%.4f,\"p99\":%.4f,\"max\":%.4f},",
+                frames ? render / frames : 0, percentile(sorted, 50), percentile(sorted, 95),
+                percentile(sorted, 99), frames ? sorted.back() : 0);
+        fprintf(f, "\"output_ms\":{\"mean\":%.4f},", frames ? output / frames : 0);
+        fprintf(f, "\"getframe_share\":%.4f,\"peak_rss_mb\":%.1f,\"histogram\":[",
+                total > 0 ? render / total : 0, peak_rss_mb());
+        for (int b = 0; b < buckets; b++)
+            fprintf(f, "%s%d", b ? "," : "", hist[b]);
+        fprintf(f, "]}\n");
+        return;
+    }
+
+    fprintf(f, "frames:     %d (after %d warm-up)\n", frames, warmup);
+    fprintf(f, "throughput: %.2f fps\n", fps);
+    if (!frames)
+        return;
+    fprintf(f, "GetFrame:   mean %.3f ms, p50 %.3f, p95 %.3f, p99 %.3f, max %.3f\n",
+            render / frames, percentile(sorted, 50), percentile(sorted, 95),
+            percentile(sorted, 99), sorted.back());
+    fprintf(f, "output:     mean %.3f ms\n", output / frames);
+    fprintf(f, "split:      %.1f%% GetFrame, %.1f%% output\n",
+            total > 0 ? render * 100 / total : 0, total > 0 ? output * 100 / total : 0);
+    fprintf(f, "peak RSS:   %.1f MB\n", peak_rss_mb());
+    for (int b = 0; b < buckets; b++) {
+        if (!b)
+            fprintf(f, "%13s ms: %d\n", "<1", hist[b]);
+        else if (b == HIST_BUCKETS-1)
+            fprintf(f, "%6s%-7d ms: %d\n", ">=", 1 << (b-1), hist[b]);
+        else
+            fprintf(f, "%6d-%-6d ms: %d\n", 1 << (b-1), 1 << b, hist[b]);
+    }
+}
@@ -0,0 +1,33 @@
+// Avs2YUV by Loren Merritt
+
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+
+#ifndef __Bench_H__
+#define __Bench_H__
+
+#include <stdio.h>
+#include <vector>
+
+// Per-frame timings for -bench. The first warmup frames are rendered but not
+// counted, so that script loading and cache fill don't skew the numbers.
+class Bench {
+    int         warmup;
+    int         seen;
+    double      first_start;
+    double      last_done;
+    std::vector<double> render_ms;   // GetFrame()
+    std::vector<double> output_ms;   // packing the planes, i.e. output without the I/O
+
+public:
+    Bench(int _warmup);
+
+    static double now(); // milliseconds from an arbitrary origin
+
+    void add(double start, double rendered, double done);
+    void report(FILE* f, bool json) const;
+};
+
+#endif // __Bench_H__
@@ -0,0 +1,120 @@
+// Avs2YUV by Loren Merritt
+
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+
+#include <string.h>
+#include "hash.h"
+
+static const uint64_t P1 = 11400714785074694791ULL;
+static const uint64_t P2 = 14029467366897019727ULL;
+static const uint64_t P3 =  1609587929392839161ULL;
+static const uint64_t P4 =  9650029242287828579ULL;
+static const uint64_t P5 =  2870177450012600261ULL;
+
+static inline uint64_t rotl(uint64_t x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+// the input is little-endian, as is every target of this program
+static inline uint64_t read64(const unsigned char* p) {
+    uint64_t v;
+    memcpy(&v, p, 8);
+    return v;
+}
+
+static inline uint32_t read32(const unsigned char* p) {
+    uint32_t v;
+    memcpy(&v, p, 4);
+    return v;
+}
+
+static inline uint64_t xxh_round(uint64_t acc, uint64_t input) {
+    acc += input * P2;
+    acc = rotl(acc, 31);
+    return acc * P1;
+}
+
+static inline uint64_t merge_round(uint64_t acc, uint64_t val) {
+    acc ^= xxh_round(0, val);
+    return acc * P1 + P4;
+}
+
+void xxh64_reset(XXH64State& s) {
+    s.v[0] = P1 + P2;
+    s.v[1] = P2;
+    s.v[2] = 0;
+    s.v[3] = 0 - P1;
+    s.total_len = 0;
+    s.memsize = 0;
+}
+
+void xxh64_update(XXH64State& s, const void* data, size_t len) {
+    const unsigned char* p = (const unsigned char*)data;
+    const unsigned char* end = p + len;
+    s.total_len += len;
+
+    if (s.memsize + len < 32) {
+        memcpy(s.mem + s.memsize, p, len);
+        s.memsize += len;
+        return;
+    }
+    if (s.memsize) {
+        size_t fill = 32 - s.memsize;
+        memcpy(s.mem + s.memsize, p, fill);
+        for (int i = 0; i < 4; i++)
+            s.v[i] = xxh_round(s.v[i], read64(s.mem + i*8));
+        p += fill;
+        s.memsize = 0;
+    }
+    // the four lanes are independent, which keeps the multipliers busy
+    uint64_t v0 = s.v[0], v1 = s.v[1], v2 = s.v[2], v3 = s.v[3];
+    for (; p + 32 <= end; p += 32) {
+        v0 = xxh_round(v0, read64(p));
+        v1 = xxh_round(v1, read64(p + 8));
+        v2 = xxh_round(v2, read64(p + 16));
+        v3 = xxh_round(v3, read64(p + 24));
+    }
+    s.v[0] = v0; s.v[1] = v1; s.v[2] = v2; s.v[3] = v3;
+    if (p < end) {
+        memcpy(s.mem, p, end - p);
+        s.memsize = end - p;
+    }
+}
+
+uint64_t xxh64_digest(const XXH64State& s) {
+    uint64_t h;
+    if (s.total_len >= 32) {
+        h = rotl(s.v[0], 1) + rotl(s.v[1], 7) + rotl(s.v[2], 12) + rotl(s.v[3], 18);
+        for (int i = 0; i < 4; i++)
+            h = merge_round(h, s.v[i]);
+    } else {
+        h = s.v[2] + P5;
+    }
+    h += s.total_len;
+
+    const unsigned char* p = s.mem;
+    const unsigned char* end = p + s.memsize;
+    for (; p + 8 <= end; p += 8) {
+        h ^= xxh_round(0, read64(p));
+        h = rotl(h, 27) * P1 + P4;
+    }
+    if (p + 4 <= end) {
+        h ^= (uint64_t)read32(p) * P1;
+        h = rotl(h, 23) * P2 + P3;
+        p += 4;
+    }
+    for (; p < end; p++) {
+        h ^= *p * P5;
+        h = rotl(h, 11) * P1;
+    }
+
+    h ^= h >> 33;
+    h *= P2;
+    h ^= h >> 29;
+    h *= P3;
+    h ^= h >> 32;
+    return h;
+}
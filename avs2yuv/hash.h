@@ -0,0 +1,27 @@
+// Avs2YUV by Loren Merritt
+
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+
+#ifndef __Hash_H__
+#define __Hash_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Streaming XXH64 (seed 0), so that a plane can be hashed row by row without
+// first copying it out of a padded frame. Digests match xxhsum -H1.
+struct XXH64State {
+    uint64_t    v[4];
+    uint64_t    total_len;
+    unsigned char mem[32];
+    size_t      memsize;
+};
+
+void     xxh64_reset(XXH64State& s);
+void     xxh64_update(XXH64State& s, const void* data, size_t len);
+uint64_t xxh64_digest(const XXH64State& s);
+
+#endif // __Hash_H__
@@ -0,0 +1,675 @@
+// Avs2YUV by Loren Merritt
+
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <ctype.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "host.h"
+#include "script.h"
+
+#ifdef _MSC_VER
+#include <direct.h>
+#include <intrin.h>
+#define getcwd _getcwd
+#define chdir _chdir
+#else
+#include <cpuid.h>
+#include <unistd.h>
+#endif
+
+// frame buffers start on a cache line
+#define POOL_ALIGN 64
+// frames a filter's cache keeps when nobody asked for a range
+#define CACHE_DEFAULT 4
+#define CACHE_MAX 64
+
+/*** avisynth.dll ***/
+
+class AvisynthHost : public Host {
+    typedef IScriptEnvironment* (__stdcall *CreateEnvFunc)(int version);
+    CreateEnvFunc create;
+
+public:
+    AvisynthHost(CreateEnvFunc _create) : create(_create) {}
+
+    IScriptEnvironment* create_env() {
+        IScriptEnvironment* env = create(AVISYNTH_INTERFACE_VERSION);
+        if (!env)
+            fprintf_s(stderr, "CreateScriptEnvironment() failed\n");
+        return env;
+    }
+};
+
+Host* create_avisynth_host() {
+    HMODULE avsdll = LoadLibrary("avisynth.dll");
+    if (!avsdll) {
+        fprintf_s(stderr, "failed to load avisynth.dll\n");
+        return NULL;
+    }
+    FARPROC create = GetProcAddress(avsdll, "CreateScriptEnvironment");
+    if (!create) {
+        fprintf_s(stderr, "failed to load CreateScriptEnvironment()\n");
+        return NULL;
+    }
+    return new AvisynthHost((IScriptEnvironment* (__stdcall *)(int))create);
+}
+
+/*** frame memory shared by all native environments ***/
+
+// Buffers and VideoFrame instances are recycled once their refcount drops to
+// zero, whichever environment they came from, so -jobs copies share one pool.
+// Everything that constructs a VideoFrame holds pool_lock until the new frame
+// is in a PVideoFrame, so a fresh frame (refcount 0) can't be handed out twice.
+static std::mutex pool_lock;
+static std::vector<VideoFrameBuffer*> pool_buffers;
+static std::vector<VideoFrame*> pool_frames;
+static __int64 pool_bytes;
+static __int64 pool_max = (__int64)512 << 20;
+
+static BYTE* alloc_frame_data(int size) {
+    return (BYTE*)_aligned_malloc(size, POOL_ALIGN);
+}
+
+static void free_frame_data(BYTE* data) {
+    _aligned_free(data);
+}
+
+// Without avisynth.dll nothing else defines these.
+VideoFrameBuffer::VideoFrameBuffer(int size)
+    : data(alloc_frame_data(size)), data_size(data ? size : 0), sequence_number(0), refcount(0) {}
+
+VideoFrameBuffer::VideoFrameBuffer() : data(NULL), data_size(0), sequence_number(0), refcount(0) {}
+
+VideoFrameBuffer::~VideoFrameBuffer() {
+    free_frame_data(data);
+}
+
+VideoFrame::VideoFrame(VideoFrameBuffer* _vfb, int _offset, int _pitch, int _row_size, int _height)
+    : refcount(0), vfb(_vfb), offset(_offset), pitch(_pitch), row_size(_row_size), height(_height),
+      offsetU(_offset), offsetV(_offset), pitchUV(0) {
+    InterlockedIncrement(&vfb->refcount);
+}
+
+VideoFrame::VideoFrame(VideoFrameBuffer* _vfb, int _offset, int _pitch, int _row_size, int _height,
+                       int _offsetU, int _offsetV, int _pitchUV)
+    : refcount(0), vfb(_vfb), offset(_offset), pitch(_pitch), row_size(_row_size), height(_height),
+      offsetU(_offsetU), offsetV(_offsetV), pitchUV(_pitchUV) {
+    InterlockedIncrement(&vfb->refcount);
+}
+
+VideoFrame* VideoFrame::Subframe(int rel_offset, int new_pitch, int new_row_size, int new_height) const {
+    return new VideoFrame(vfb, offset+rel_offset, new_pitch, new_row_size, new_height);
+}
+
+VideoFrame* VideoFrame::Subframe(int rel_offset, int new_pitch, int new_row_size, int new_height,
+                                 int rel_offsetU, int rel_offsetV, int new_pitchUV) const {
+    return new VideoFrame(vfb, offset+rel_offset, new_pitch, new_row_size, new_height,
+                          offsetU+rel_offsetU, offsetV+rel_offsetV, new_pitchUV);
+}
+
+// caller holds pool_lock
+void* VideoFrame::operator new(unsigned) {
+    for (size_t i = 0; i < pool_frames.size(); i++)
+        if (!pool_frames[i]->refcount)
+            return pool_frames[i];
+    VideoFrame* vf = (VideoFrame*)::operator new(sizeof(VideoFrame));
+    pool_frames.push_back(vf);
+    return vf;
+}
+
+// caller holds pool_lock; the smallest free buffer that fits
+static VideoFrameBuffer* get_frame_buffer(int size) {
+    VideoFrameBuffer* best = NULL;
+    for (size_t i = 0; i < pool_buffers.size(); i++) {
+        VideoFrameBuffer* vfb = pool_buffers[i];
+        if (!vfb->GetRefcount() && vfb->GetDataSize() >= size && (!best || vfb->GetDataSize() < best->GetDataSize()))
+            best = vfb;
+    }
+    if (best)
+        return best;
+    // over the limit: give back the idle buffers before growing
+    if (pool_bytes + size > pool_max) {
+        for (size_t i = pool_buffers.size(); i-- > 0; ) {
+            VideoFrameBuffer* vfb = pool_buffers[i];
+            if (!vfb->GetRefcount()) {
+                pool_bytes -= vfb->GetDataSize();
+                delete vfb;
+                pool_buffers.erase(pool_buffers.begin() + i);
+            }
+        }
+    }
+    VideoFrameBuffer* vfb = new VideoFrameBuffer(size);
+    if (!vfb->GetDataSize()) {
+        delete vfb;
+        return NULL;
+    }
+    pool_buffers.push_back(vfb);
+    pool_bytes += size;
+    return vfb;
+}
+
+/*** the native environment ***/
+
+// Avisynth puts a cache behind every filter. Filters that look at neighbouring
+// frames (TFM, TDecimate, ...) rely on it to not render everything repeatedly.
+class FrameCache : public GenericVideoFilter {
+    struct Entry {
+        int         n;
+        PVideoFrame frame;
+    };
+    std::deque<Entry> entries;  // most recently used last
+    size_t      capacity;
+    bool        range_hint;
+
+public:
+    FrameCache(PClip _child) : GenericVideoFilter(_child), capacity(CACHE_DEFAULT), range_hint(false) {}
+
+    PVideoFrame __stdcall GetFrame(int n, IScriptEnvironment* env) {
+        for (size_t i = entries.size(); i-- > 0; ) {
+            if (entries[i].n == n) {
+                Entry e = entries[i];
+                entries.erase(entries.begin() + i);
+                entries.push_back(e);
+                return e.frame;
+            }
+        }
+        PVideoFrame f = child->GetFrame(n, env);
+        if (capacity) {
+            if (entries.size() >= capacity)
+                entries.pop_front();
+            Entry e = { n, f };
+            entries.push_back(e);
+        }
+        return f;
+    }
+
+    // CACHE_RANGE asks for the frames within frame_range of the current one
+    void __stdcall SetCacheHints(int cachehints, int frame_range) {
+        if (cachehints == CACHE_RANGE) {
+            range_hint = true;
+            capacity = max(capacity, (size_t)min(max(frame_range, 0) * 2 + 1, CACHE_MAX));
+        } else if (cachehints == CACHE_NOTHING && !range_hint) {
+            capacity = 0;
+            entries.clear();
+        }
+    }
+};
+
+// IT_TFF/IT_BFF switches that scripts commonly put in front of field matchers
+class AssumeFieldOrder : public GenericVideoFilter {
+public:
+    AssumeFieldOrder(PClip _child, bool tff) : GenericVideoFilter(_child) {
+        vi.Clear(tff ? VideoInfo::IT_BFF : VideoInfo::IT_TFF);
+        vi.Set(tff ? VideoInfo::IT_TFF : VideoInfo::IT_BFF);
+    }
+    bool __stdcall GetParity(int n) {
+        return vi.IsTFF() ? true : vi.IsBFF() ? false : child->GetParity(n);
+    }
+};
+
+static long detect_cpu_flags() {
+    int info[4];
+#ifdef _MSC_VER
+    __cpuid(info, 1);
+#else
+    unsigned a, b, c, d;
+    if (!__get_cpuid(1, &a, &b, &c, &d))
+        return CPUF_FPU;
+    info[2] = c;
+    info[3] = d;
+#endif
+    long flags = CPUF_FPU;
+    if (info[3] & (1<<23))
+        flags |= CPUF_MMX;
+    if (info[3] & (1<<25))
+        flags |= CPUF_SSE | CPUF_INTEGER_SSE;
+    if (info[3] & (1<<26))
+        flags |= CPUF_SSE2;
+    return flags;
+}
+
+// The name lets it construct frames through the friend declarations in
+// avisynth.h. Each instance is used by one thread, as with avisynth.dll.
+class ScriptEnvironment : public IScriptEnvironment {
+    struct Function {
+        std::string name;
+        std::string params;
+        ApplyFunc   apply;
+        void*       user_data;
+    };
+
+    // one parsed entry of a parameter string such as "c[order]i[pp]i"
+    struct Param {
+        std::string name;       // empty unless optional
+        char        type;       // c, i, f, b, s or . for anything
+        char        repeat;     // 0, '*' or '+'
+    };
+
+    typedef std::map<std::string, AVSValue> VarTable;
+
+    std::vector<Function> functions;
+    VarTable    globals;
+    std::vector<VarTable> contexts;     // innermost last
+    std::deque<std::string> strings;
+    std::vector<std::pair<ShutdownFunc, void*> > at_exit;
+    std::vector<HMODULE> libraries;
+    long        cpu_flags;
+
+    static std::string key(const char* name) {
+        std::string k(name);
+        for (size_t i = 0; i < k.size(); i++)
+            k[i] = (char)tolower((unsigned char)k[i]);
+        return k;
+    }
+
+    static bool parse_params(const char* s, std::vector<Param>& params) {
+        while (*s) {
+            Param p;
+            if (*s == '[') {
+                const char* end = strchr(s, ']');
+                if (!end)
+                    return false;
+                p.name.assign(s+1, end);
+                s = end + 1;
+            }
+            if (!*s || !strchr("cifbs.", *s))
+                return false;
+            p.type = *s++;
+            p.repeat = 0;
+            if (*s == '*' || *s == '+')
+                p.repeat = *s++;
+            params.push_back(p);
+        }
+        return true;
+    }
+
+    static bool type_matches(char type, const AVSValue& v) {
+        switch (type) {
+        case 'c': return v.IsClip();
+        case 'i': return v.IsInt();
+        case 'f': return v.IsFloat();   // ints too
+        case 'b': return v.IsBool();
+        case 's': return v.IsString();
+        default:  return true;
+        }
+    }
+
+    // Binds positional arguments in order and then the named ones, the way
+    // avisynth does; optional parameters may be passed either way. Returns
+    // false if the positional arguments don't fit this signature.
+    bool bind_args(const Function& f, const std::vector<AVSValue>& in, const char** names,
+                   std::vector<AVSValue>& out, std::vector<std::vector<AVSValue> >& arrays) {
+        std::vector<Param> params;
+        if (!parse_params(f.params.c_str(), params))
+            ThrowError("%s: bad parameter string \"%s\"", f.name.c_str(), f.params.c_str());
+        size_t positional = 0;
+        while (positional < in.size() && !(names && names[positional]))
+            positional++;
+
+        out.assign(params.size(), AVSValue());
+        arrays.assign(params.size(), std::vector<AVSValue>());
+        size_t a = 0;
+        for (size_t i = 0; i < params.size(); i++) {
+            const Param& p = params[i];
+            if (p.repeat) {
+                while (a < positional && type_matches(p.type, in[a]))
+                    arrays[i].push_back(in[a++]);
+                if (p.repeat == '+' && arrays[i].empty())
+                    return false;
+                out[i] = AVSValue(arrays[i].data(), (int)arrays[i].size());
+            } else if (a < positional) {
+                if (!type_matches(p.type, in[a]) && !(in[a].Defined() == false && !p.name.empty()))
+                    return false;
+                out[i] = in[a++];
+            } else if (p.name.empty()) {
+                return false;
+            }
+        }
+        if (a < positional)
+            return false;
+
+        for (size_t j = positional; j < in.size(); j++) {
+            if (!names || !names[j])
+                ThrowError("Script error: positional argument after named ones in call to %s", f.name.c_str());
+            size_t i = 0;
+            while (i < params.size() && !(!params[i].name.empty() && names_equal(params[i].name.c_str(), names[j])))
+                i++;
+            if (i == params.size())
+                ThrowError("Script error: %s does not have a named argument \"%s\"", f.name.c_str(), names[j]);
+            if (out[i].Defined())
+                ThrowError("Script error: the argument \"%s\" to %s was given more than once", names[j], f.name.c_str());
+            if (!type_matches(params[i].type, in[j]))
+                ThrowError("Script error: the named argument \"%s\" to %s had the wrong type", names[j], f.name.c_str());
+            out[i] = in[j];
+        }
+        return true;
+    }
+
+    PVideoFrame new_frame(int row_size, int height, bool planar, bool u_first, int align) {
+        align = max(align, FRAME_ALIGN);
+        const int pitch = (row_size + align-1) & ~(align-1);
+        int size = pitch * height, offset_first = 0, offset_second = 0, pitchUV = 0;
+        if (planar) {
+            // chroma at half the luma pitch, V first for YV12
+            pitchUV = pitch >> 1;
+            offset_first = size;
+            offset_second = offset_first + pitchUV * (height >> 1);
+            size = offset_second + pitchUV * (height >> 1);
+        }
+        if (align > POOL_ALIGN)
+            size += align;
+
+        std::lock_guard<std::mutex> lock(pool_lock);
+        VideoFrameBuffer* vfb = get_frame_buffer(size);
+        if (!vfb)
+            ThrowError("NewVideoFrame: out of memory");
+        const int offset = (int)(-(intptr_t)vfb->GetReadPtr() & (align-1));
+        if (!planar)
+            return new VideoFrame(vfb, offset, pitch, row_size, height);
+        const int offsetU = offset + (u_first ? offset_first : offset_second);
+        const int offsetV = offset + (u_first ? offset_second : offset_first);
+        return new VideoFrame(vfb, offset, pitch, row_size, height, offsetU, offsetV, pitchUV);
+    }
+
+    static AVSValue __cdecl import_scripts(AVSValue args, void*, IScriptEnvironment* env) {
+        AVSValue result;
+        for (int i = 0; i < args[0].ArraySize(); i++)
+            result = import_file(args[0][i].AsString(""), env);
+        return result;
+    }
+
+    static AVSValue import_file(const char* path, IScriptEnvironment* env) {
+        FILE* f = fopen(path, "rb");
+        if (!f)
+            env->ThrowError("Import: couldn't open \"%s\"", path);
+        std::string text;
+        char buf[4096];
+        size_t n;
+        while ((n = fread(buf, 1, sizeof(buf), f)) > 0)
+            text.append(buf, n);
+        fclose(f);
+
+        // file names in the script are relative to the script, as in avisynth
+        const char* slash = strrchr(path, '/');
+        const char* backslash = strrchr(path, '\\');
+        if (backslash > slash)
+            slash = backslash;
+        char* cwd = getcwd(NULL, 0);
+        if (slash && cwd)
+            env->SetWorkingDir(std::string(path, slash == path ? 1 : slash-path).c_str());
+        AVSValue result;
+        try {
+            result = eval_script(text.c_str(), path, env);
+        } catch (...) {
+            if (cwd) {
+                env->SetWorkingDir(cwd);
+                free(cwd);
+            }
+            throw;
+        }
+        if (cwd) {
+            env->SetWorkingDir(cwd);
+            free(cwd);
+        }
+        return result;
+    }
+
+    static AVSValue __cdecl load_plugins(AVSValue args, void*, IScriptEnvironment* env) {
+        AVSValue result;
+        for (int i = 0; i < args[0].ArraySize(); i++)
+            result = ((ScriptEnvironment*)env)->load_plugin(args[0][i].AsString(""));
+        return result;
+    }
+
+    static AVSValue __cdecl assume_tff(AVSValue args, void*, IScriptEnvironment*) {
+        return new AssumeFieldOrder(args[0].AsClip(), true);
+    }
+
+    static AVSValue __cdecl assume_bff(AVSValue args, void*, IScriptEnvironment*) {
+        return new AssumeFieldOrder(args[0].AsClip(), false);
+    }
+
+public:
+    ScriptEnvironment() : contexts(1), cpu_flags(detect_cpu_flags()) {
+        AddFunction("Import", "s+", import_scripts, NULL);
+        AddFunction("LoadPlugin", "s+", load_plugins, NULL);
+        AddFunction("AssumeTFF", "c", assume_tff, NULL);
+        AddFunction("AssumeBFF", "c", assume_bff, NULL);
+    }
+
+    ~ScriptEnvironment() {
+        for (size_t i = at_exit.size(); i-- > 0; )
+            at_exit[i].first(at_exit[i].second, this);
+        // the plugins' clips have to go before their code does
+        contexts.clear();
+        globals.clear();
+        for (size_t i = 0; i < libraries.size(); i++)
+            FreeLibrary(libraries[i]);
+    }
+
+    // calls the plugin's AvisynthPluginInit2(), which registers its functions
+    const char* load_plugin(const char* path) {
+        typedef const char* (__stdcall *PluginInitFunc)(IScriptEnvironment* env);
+        HMODULE lib = LoadLibrary(path);
+        FARPROC init = lib ? GetProcAddress(lib, "AvisynthPluginInit2") : NULL;
+        if (lib && !init)
+            init = GetProcAddress(lib, "_AvisynthPluginInit2@4");
+        if (!lib)
+            ThrowError("LoadPlugin: unable to load \"%s\"", path);
+        libraries.push_back(lib);
+        if (!init)
+            ThrowError("LoadPlugin: \"%s\" is not an Avisynth 2.5 plugin", path);
+        return ((PluginInitFunc)init)(this);
+    }
+
+    long __stdcall GetCPUFlags() {
+        return cpu_flags;
+    }
+
+    char* __stdcall SaveString(const char* s, int length = -1) {
+        if (length < 0)
+            length = (int)strlen(s);
+        strings.push_back(std::string(s, length));
+        return &strings.back()[0];
+    }
+
+    char* __stdcall Sprintf(const char* fmt, ...) {
+        va_list ap;
+        va_start(ap, fmt);
+        char* s = format(fmt, ap);
+        va_end(ap);
+        return s;
+    }
+
+    char* __stdcall VSprintf(const char* fmt, void* val) {
+        return format(fmt, (va_list)val);
+    }
+
+    char* format(const char* fmt, va_list ap) {
+        va_list copy;
+        va_copy(copy, ap);
+        int len = vsnprintf(NULL, 0, fmt, copy);
+        va_end(copy);
+        if (len < 0)
+            return SaveString(fmt);
+        strings.push_back(std::string(len, '\0'));
+        std::string& s = strings.back();
+        vsnprintf(&s[0], len+1, fmt, ap);
+        return &s[0];
+    }
+
+    __declspec(noreturn) void __stdcall ThrowError(const char* fmt, ...) {
+        va_list ap;
+        va_start(ap, fmt);
+        char* msg = format(fmt, ap);
+        va_end(ap);
+        throw AvisynthError(msg);
+    }
+
+    void __stdcall AddFunction(const char* name, const char* params, ApplyFunc apply, void* user_data) {
+        Function f = { name, params, apply, user_data };
+        functions.push_back(f);
+    }
+
+    bool __stdcall FunctionExists(const char* name) {
+        for (size_t i = 0; i < functions.size(); i++)
+            if (names_equal(functions[i].name.c_str(), name))
+                return true;
+        return false;
+    }
+
+    // Every clip a function returns gets a cache in front of it, as in avisynth.
+    AVSValue __stdcall Invoke(const char* name, const AVSValue args, const char** arg_names) {
+        std::vector<AVSValue> in;
+        if (args.IsArray()) {
+            for (int i = 0; i < args.ArraySize(); i++)
+                in.push_back(args[i]);
+        } else {
+            in.push_back(args);
+        }
+        std::vector<AVSValue> out;
+        std::vector<std::vector<AVSValue> > arrays;
+        // functions registered later (plugins) override earlier ones
+        for (size_t i = functions.size(); i-- > 0; ) {
+            const Function& f = functions[i];
+            if (!names_equal(f.name.c_str(), name) || !bind_args(f, in, arg_names, out, arrays))
+                continue;
+            AVSValue result = f.apply(AVSValue(out.data(), (int)out.size()), f.user_data, this);
+            // an imported script's clip already came out of a function
+            if (result.IsClip() && f.apply != import_scripts)
+                result = new FrameCache(result.AsClip());
+            return result;
+        }
+        throw NotFound();
+    }
+
+    AVSValue __stdcall GetVar(const char* name) {
+        std::string k = key(name);
+        for (size_t i = contexts.size(); i-- > 0; ) {
+            VarTable::const_iterator it = contexts[i].find(k);
+            if (it != contexts[i].end())
+                return it->second;
+        }
+        VarTable::const_iterator it = globals.find(k);
+        if (it == globals.end())
+            throw NotFound();
+        return it->second;
+    }
+
+    // returns true if the variable is new
+    bool __stdcall SetVar(const char* name, const AVSValue& val) {
+        VarTable& vars = contexts.back();
+        std::pair<VarTable::iterator, bool> r = vars.insert(VarTable::value_type(key(name), val));
+        if (!r.second)
+            r.first->second = val;
+        return r.second;
+    }
+
+    bool __stdcall SetGlobalVar(const char* name, const AVSValue& val) {
+        std::pair<VarTable::iterator, bool> r = globals.insert(VarTable::value_type(key(name), val));
+        if (!r.second)
+            r.first->second = val;
+        return r.second;
+    }
+
+    void __stdcall PushContext(int) {
+        contexts.push_back(VarTable());
+    }
+
+    void __stdcall PopContext() {
+        if (contexts.size() > 1)
+            contexts.pop_back();
+    }
+
+    PVideoFrame __stdcall NewVideoFrame(const VideoInfo& vi, int align) {
+        return new_frame(vi.RowSize(), vi.height, vi.IsPlanar(), !vi.IsVPlaneFirst(), abs(align));
+    }
+
+    bool __stdcall MakeWritable(PVideoFrame* pvf) {
+        const PVideoFrame& src = *pvf;
+        if (src->IsWritable())
+            return false;
+        const bool planar = src->GetPitch(PLANAR_U) != 0;
+        PVideoFrame dst = new_frame(src->GetRowSize(), src->GetHeight(), planar,
+                                    src->GetOffset(PLANAR_U) < src->GetOffset(PLANAR_V), FRAME_ALIGN);
+        BitBlt(dst->GetWritePtr(), dst->GetPitch(), src->GetReadPtr(), src->GetPitch(), src->GetRowSize(), src->GetHeight());
+        if (planar) {
+            BitBlt(dst->GetWritePtr(PLANAR_U), dst->GetPitch(PLANAR_U), src->GetReadPtr(PLANAR_U), src->GetPitch(PLANAR_U),
+                   src->GetRowSize(PLANAR_U), src->GetHeight(PLANAR_U));
+            BitBlt(dst->GetWritePtr(PLANAR_V), dst->GetPitch(PLANAR_V), src->GetReadPtr(PLANAR_V), src->GetPitch(PLANAR_V),
+                   src->GetRowSize(PLANAR_V), src->GetHeight(PLANAR_V));
+        }
+        *pvf = dst;
+        return true;
+    }
+
+    void __stdcall BitBlt(BYTE* dstp, int dst_pitch, const BYTE* srcp, int src_pitch, int row_size, int height) {
+        if (dst_pitch == row_size && src_pitch == row_size) {
+            memcpy(dstp, srcp, (size_t)row_size * height);
+            return;
+        }
+        for (int y = 0; y < height; y++, dstp += dst_pitch, srcp += src_pitch)
+            memcpy(dstp, srcp, row_size);
+    }
+
+    void __stdcall AtExit(ShutdownFunc function, void* user_data) {
+        at_exit.push_back(std::make_pair(function, user_data));
+    }
+
+    void __stdcall CheckVersion(int version) {
+        if (version > AVISYNTH_INTERFACE_VERSION)
+            ThrowError("Plugin was designed for a later version of Avisynth (%d)", version);
+    }
+
+    PVideoFrame __stdcall Subframe(PVideoFrame src, int rel_offset, int new_pitch, int new_row_size, int new_height) {
+        std::lock_guard<std::mutex> lock(pool_lock);
+        return src->Subframe(rel_offset, new_pitch, new_row_size, new_height);
+    }
+
+    // in MB, for the pool shared by all environments
+    int __stdcall SetMemoryMax(int mem) {
+        std::lock_guard<std::mutex> lock(pool_lock);
+        if (mem > 0)
+            pool_max = (__int64)mem << 20;
+        return (int)(pool_max >> 20);
+    }
+
+    int __stdcall SetWorkingDir(const char* newdir) {
+        return chdir(newdir) ? 1 : 0;
+    }
+};
+
+class NativeHost : public Host {
+    std::vector<std::string> plugins;
+
+public:
+    NativeHost(const std::vector<const char*>& _plugins) : plugins(_plugins.begin(), _plugins.end()) {}
+
+    IScriptEnvironment* create_env() {
+        ScriptEnvironment* env = new ScriptEnvironment;
+        try {
+            for (size_t i = 0; i < plugins.size(); i++)
+                env->load_plugin(plugins[i].c_str());
+        } catch (const AvisynthError& e) {
+            fprintf_s(stderr, "%s\n", e.msg);
+            delete env;
+            return NULL;
+        }
+        return env;
+    }
+};
+
+Host* create_native_host(const std::vector<const char*>& plugins) {
+    return new NativeHost(plugins);
+}
@@ -0,0 +1,31 @@
+// Avs2YUV by Loren Merritt
+
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+
+#ifndef __Host_H__
+#define __Host_H__
+
+#include <vector>
+#include "internal.h"
+
+// Where the script environments come from. Every environment handed out is
+// independent, so each -jobs copy of the script gets its own.
+class Host {
+public:
+    virtual ~Host() {}
+    // returns NULL after printing the reason
+    virtual IScriptEnvironment* create_env() = 0;
+};
+
+// avisynth.dll and its CreateScriptEnvironment(); NULL if it can't be loaded
+Host* create_avisynth_host();
+
+// A built-in environment that loads 2.5 plugins itself and runs a small
+// subset of the script language (see script.h), so no avisynth.dll is
+// needed. The plugins are loaded into every environment before the script.
+Host* create_native_host(const std::vector<const char*>& plugins);
+
+#endif // __Host_H__
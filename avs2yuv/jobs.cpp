@@ -0,0 +1,192 @@
+// Avs2YUV by Loren Merritt
+
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+
+#include <string>
+#include <process.h>
+#include "jobs.h"
+
+// Each job packs its frames into a private ring, so that every PVideoFrame is
+// released on the thread (and in the environment) that produced it.
+struct JobState {
+    Job*        job;
+    int         index;
+    int         jobs;
+    int         first;
+    int         last;
+    int         chunk;
+    const Outputs* out;
+    bool        positional;
+    bool        verbose;
+    std::vector<BYTE> ring;
+    int         depth;
+    int         read_slot;
+    int         consumed;
+    int         written;        // frames this job wrote into place
+    HANDLE      free_slots;
+    HANDLE      used_slots;
+    HANDLE      thread;
+    volatile bool* stop;
+    // set by the job when GetFrame() throws
+    bool        failed;
+    int         failed_after;   // frames delivered before the error
+    int         failed_frame;
+    std::string error;
+};
+
+static unsigned __stdcall job_thread(void* arg) {
+    JobState* js = (JobState*)arg;
+    int slot = 0;
+    int produced = 0;
+    int frm = -1;
+    try {
+        for (int run = js->first + js->index*js->chunk; run < js->last; run += js->jobs*js->chunk) {
+            int run_end = min(run + js->chunk, js->last);
+            for (frm = run; frm < run_end; frm++) {
+                if (!js->positional)
+                    WaitForSingleObject(js->free_slots, INFINITE);
+                if (*js->stop)
+                    return 0;
+                PVideoFrame f = js->job->clip->GetFrame(frm, js->job->env.get());
+                if (js->positional) {
+                    pack_frame(f, *js->out, &js->ring[0]);
+                    if (!write_frame_at(&js->ring[0], frm - js->first, *js->out)) {
+                        js->failed = true;
+                        *js->stop = true;
+                        return 0;
+                    }
+                    js->written++;
+                    if (js->verbose)
+                        fprintf_s(stderr, "%d\n", frm);
+                    continue;
+                }
+                if (any_outputs(*js->out))
+                    pack_frame(f, *js->out, &js->ring[(size_t)slot * js->out->frame_size]);
+                slot = (slot + 1) % js->depth;
+                produced++;
+                ReleaseSemaphore(js->used_slots, 1, NULL);
+            }
+        }
+    } catch (AvisynthError err) {
+        js->error = err.msg;
+        js->failed_frame = frm;
+        js->failed_after = produced;
+        js->failed = true;
+        if (js->positional)
+            *js->stop = true;
+        else
+            ReleaseSemaphore(js->used_slots, 1, NULL);
+    }
+    return 0;
+}
+
+// The stream index of the first frame js hasn't written into place, or the
+// stream length if it wrote all of its frames.
+static int first_missing(const JobState& js) {
+    int run = js.written / js.chunk * js.jobs + js.index;
+    return min(run*js.chunk + js.written % js.chunk, js.last - js.first);
+}
+
+// Positional outputs need no reordering: the jobs write directly, and the
+// main thread only waits for them. If one fails the others stop wherever
+// they are, and only the frames before the first gap count as written.
+static int wait_for_jobs(std::vector<JobState>& states, int first, int last, Outputs& out) {
+    int ret = 0;
+    out.written = last - first;
+    for (size_t j = 0; j < states.size(); j++) {
+        WaitForSingleObject(states[j].thread, INFINITE);
+        CloseHandle(states[j].thread);
+    }
+    for (size_t j = 0; j < states.size(); j++) {
+        JobState& js = states[j];
+        if (js.failed && !js.error.empty())
+            fprintf_s(stderr, "\nAvisynth error at frame %d:\n%s\n", js.failed_frame, js.error.c_str());
+        if (js.failed)
+            ret = 1;
+        out.written = min(out.written, first_missing(js));
+        CloseHandle(js.free_slots);
+        CloseHandle(js.used_slots);
+    }
+    return ret;
+}
+
+int default_chunk(int jobs, const Outputs& out, bool positional) {
+    if (positional || !any_outputs(out))
+        return DEFAULT_CHUNK;
+    size_t fit = RING_BUDGET / ((size_t)jobs * out.frame_size);
+    return (int)max(min(fit, (size_t)DEFAULT_CHUNK), (size_t)MIN_CHUNK);
+}
+
+int render_jobs(std::vector<Job>& jobs, int first, int last, int chunk, Outputs& out, bool positional, bool verbose) {
+    int n = (int)jobs.size();
+    volatile bool stop = false;
+    std::vector<JobState> states(n);
+    int ret = 0;
+
+    for (int j = 0; j < n; j++) {
+        JobState& js = states[j];
+        js.job = &jobs[j];
+        js.index = j;
+        js.jobs = n;
+        js.first = first;
+        js.last = last;
+        js.chunk = chunk;
+        js.out = &out;
+        js.positional = positional;
+        js.verbose = verbose;
+        // a whole run
+        js.depth = positional ? 1 : chunk;
+        js.ring.resize(any_outputs(out) ? (size_t)js.depth * out.frame_size : 0);
+        js.read_slot = 0;
+        js.consumed = 0;
+        js.written = 0;
+        js.free_slots = CreateSemaphore(NULL, js.depth, js.depth + 1, NULL);
+        js.used_slots = CreateSemaphore(NULL, 0, js.depth + 1, NULL);
+        js.stop = &stop;
+        js.failed = false;
+    }
+    for (int j = 0; j < n; j++) {
+        unsigned tid;
+        states[j].thread = (HANDLE)_beginthreadex(0, 0, &job_thread, &states[j], 0, &tid);
+    }
+    if (positional)
+        return wait_for_jobs(states, first, last, out);
+
+    for (int run = first, r = 0; run < last && !ret; run += chunk, r++) {
+        JobState& js = states[r % n];
+        int run_end = min(run + chunk, last);
+        for (int frm = run; frm < run_end; frm++) {
+            WaitForSingleObject(js.used_slots, INFINITE);
+            if (js.failed && js.consumed == js.failed_after) {
+                fprintf_s(stderr, "\nAvisynth error at frame %d:\n%s\n", js.failed_frame, js.error.c_str());
+                ret = 1;
+                break;
+            }
+            if (any_outputs(out)) {
+                const BYTE* buf = &js.ring[(size_t)js.read_slot * out.frame_size];
+                if (!write_frame(packed_planes(buf, out), frm, out)) {
+                    ret = 1;
+                    break;
+                }
+            }
+            js.read_slot = (js.read_slot + 1) % js.depth;
+            js.consumed++;
+            ReleaseSemaphore(js.free_slots, 1, NULL);
+            if (verbose)
+                fprintf_s(stderr, "%d\n", frm);
+        }
+    }
+
+    stop = true;
+    for (int j = 0; j < n; j++) {
+        ReleaseSemaphore(states[j].free_slots, 1, NULL);
+        WaitForSingleObject(states[j].thread, INFINITE);
+        CloseHandle(states[j].thread);
+        CloseHandle(states[j].free_slots);
+        CloseHandle(states[j].used_slots);
+    }
+    return ret;
+}
@@ -0,0 +1,43 @@
+// Avs2YUV by Loren Merritt
+
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+
+#ifndef __Jobs_H__
+#define __Jobs_H__
+
+#include <memory>
+#include <vector>
+#include "output.h"
+
+#define MAX_JOBS 32
+
+// Every run starts with a seek, which for MPEG2Source means decoding from the
+// start of a GOP and the temporal filters refilling their caches, so a run
+// should span many GOPs.
+#define DEFAULT_CHUNK 300
+// Frames written in order wait in the jobs' rings until the earlier runs are
+// out, so that costs about jobs * chunk frames of memory. The default is cut
+// down to stay within RING_BUDGET there, but not below MIN_CHUNK.
+#define RING_BUDGET ((size_t)512 << 20)
+#define MIN_CHUNK 16
+
+// one script environment with its own instance of the filter chain
+struct Job {
+    std::shared_ptr<IScriptEnvironment> env;
+    PClip       clip;
+};
+
+// the -chunk default for this many jobs
+int default_chunk(int jobs, const Outputs& out, bool positional);
+
+// Splits first..last-1 into runs of chunk frames that are dealt out to the
+// jobs round-robin, each job rendering its runs in order on its own thread.
+// The main thread writes the frames out in frame order, unless positional is
+// set (see preallocate_outputs()), in which case every job writes its own
+// frames into place as soon as they're done. Returns the exit code.
+int render_jobs(std::vector<Job>& jobs, int first, int last, int chunk, Outputs& out, bool positional, bool verbose);
+
+#endif // __Jobs_H__
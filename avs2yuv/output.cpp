@@ -0,0 +1,322 @@
+// Avs2YUV by Loren Merritt
+
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <io.h>
+#include <emmintrin.h>
+#include "output.h"
+#include "hash.h"
+
+#ifdef _MSC_VER
+#define fileno _fileno
+#define write _write
+#define lseek64 _lseeki64
+#else
+#include <unistd.h>
+#endif
+
+static const char frame_header[] = "FRAME\n";
+static const int  frame_header_len = 6;
+
+static const int planes[] = {PLANAR_Y, PLANAR_U, PLANAR_V};
+
+static int plane_width(const Outputs& out, int p) {
+    return out.width >> (p ? 1 : 0);
+}
+
+static int plane_height(const Outputs& out, int p) {
+    return out.height >> (p ? out.chroma_h_shift : 0);
+}
+
+// Splits one row of YUY2 into its Y, U and V parts, 32 pixels at a time.
+static void deinterleave_yuy2(const BYTE* src, BYTE* y, BYTE* u, BYTE* v, int width) {
+    const __m128i lo = _mm_set1_epi16(0x00ff);
+    int x = 0;
+    for (; x + 32 <= width; x += 32) {
+        __m128i a0 = _mm_loadu_si128((const __m128i*)(src + x*2));
+        __m128i a1 = _mm_loadu_si128((const __m128i*)(src + x*2 + 16));
+        __m128i a2 = _mm_loadu_si128((const __m128i*)(src + x*2 + 32));
+        __m128i a3 = _mm_loadu_si128((const __m128i*)(src + x*2 + 48));
+        __m128i y0 = _mm_packus_epi16(_mm_and_si128(a0, lo), _mm_and_si128(a1, lo));
+        __m128i y1 = _mm_packus_epi16(_mm_and_si128(a2, lo), _mm_and_si128(a3, lo));
+        __m128i c0 = _mm_packus_epi16(_mm_srli_epi16(a0, 8), _mm_srli_epi16(a1, 8));
+        __m128i c1 = _mm_packus_epi16(_mm_srli_epi16(a2, 8), _mm_srli_epi16(a3, 8));
+        _mm_storeu_si128((__m128i*)(y + x), y0);
+        _mm_storeu_si128((__m128i*)(y + x + 16), y1);
+        _mm_storeu_si128((__m128i*)(u + x/2), _mm_packus_epi16(_mm_and_si128(c0, lo), _mm_and_si128(c1, lo)));
+        _mm_storeu_si128((__m128i*)(v + x/2), _mm_packus_epi16(_mm_srli_epi16(c0, 8), _mm_srli_epi16(c1, 8)));
+    }
+    for (; x < width; x += 2) {
+        y[x]     = src[x*2];
+        u[x/2]   = src[x*2 + 1];
+        y[x + 1] = src[x*2 + 2];
+        v[x/2]   = src[x*2 + 3];
+    }
+}
+
+// Collects the FRAME header and the Y/U/V rows of f, merging rows into a
+// single span per plane whenever the plane has no padding.
+static int gather_frame(const FramePlanes& f, Outputs& out) {
+    Span* s = &out.spans[0];
+    int n = 0;
+
+    s[n].data = (const BYTE*)frame_header;
+    s[n++].len = frame_header_len;
+    for (int p = 0; p < 3; p++) {
+        int w = plane_width(out, p);
+        int h = plane_height(out, p);
+        int pitch = f.pitch[p];
+        const BYTE* data = f.data[p];
+        if (pitch == w) {
+            s[n].data = data;
+            s[n++].len = (size_t)w * h;
+            continue;
+        }
+        for (int y = 0; y < h; y++) {
+            s[n].data = data;
+            s[n++].len = w;
+            data += pitch;
+        }
+    }
+    return n;
+}
+
+static bool write_all(int fd, const BYTE* data, size_t len) {
+    while (len) {
+        int chunk = (int)min(len, (size_t)1<<30);
+        int n = write(fd, data, chunk);
+        if (n <= 0)
+            return false;
+        data += n;
+        len -= n;
+    }
+    return true;
+}
+
+void init_outputs(Outputs& out, const VideoInfo& vi) {
+    out.width = vi.width;
+    out.height = vi.height;
+    out.yuy2 = vi.IsYUY2();
+    out.chroma_h_shift = out.yuy2 ? 0 : 1;
+    out.frame_size = out.width*out.height + (out.width >> 1)*(out.height >> out.chroma_h_shift)*2;
+    for (int i = 0; i < out.count; i++) {
+        out.fd[i] = fileno(out.fh[i]);
+        out.positional[i] = false;
+    }
+    out.written = 0;
+    out.spans.resize(1 + out.height + (out.height >> out.chroma_h_shift)*2);
+    out.planar.resize(out.yuy2 ? out.frame_size : 0);
+    out.pack = (BYTE*)_aligned_malloc(frame_header_len + out.frame_size, 64);
+}
+
+void free_outputs(Outputs& out) {
+    _aligned_free(out.pack);
+    out.pack = NULL;
+}
+
+static FramePlanes frame_planes(const PVideoFrame& f) {
+    FramePlanes fp;
+    for (int p = 0; p < 3; p++) {
+        fp.data[p] = f->GetReadPtr(planes[p]);
+        fp.pitch[p] = f->GetPitch(planes[p]);
+    }
+    return fp;
+}
+
+bool write_frame(const PVideoFrame& f, int frm, Outputs& out) {
+    if (!out.yuy2)
+        return write_frame(frame_planes(f), frm, out);
+    pack_frame(f, out, &out.planar[0]);
+    return write_frame(packed_planes(&out.planar[0], out), frm, out);
+}
+
+static bool write_hashes(const FramePlanes& f, int frm, const Outputs& out) {
+    uint64_t h[3];
+    for (int p = 0; p < 3; p++) {
+        XXH64State s;
+        xxh64_reset(s);
+        int w = plane_width(out, p);
+        int rows = plane_height(out, p);
+        if (f.pitch[p] == w) {
+            xxh64_update(s, f.data[p], (size_t)w * rows);
+        } else {
+            for (int y = 0; y < rows; y++)
+                xxh64_update(s, f.data[p] + y*f.pitch[p], w);
+        }
+        h[p] = xxh64_digest(s);
+    }
+    // flushed every line so -slave controllers can read each frame's hashes
+    // as soon as it's done
+    if (fprintf(out.hash_fh, "%d %016llx %016llx %016llx\n", frm,
+                (unsigned long long)h[0], (unsigned long long)h[1], (unsigned long long)h[2]) < 0
+        || fflush(out.hash_fh)) {
+        fprintf_s(stderr, "Output error: couldn't write hashes of frame %d\n", frm);
+        return false;
+    }
+    return true;
+}
+
+bool write_frame(const FramePlanes& f, int frm, Outputs& out) {
+    if (out.hash_fh && !write_hashes(f, frm, out))
+        return false;
+    if (!out.count)
+        return true;
+
+    int n = gather_frame(f, out);
+    int wrote = 0;
+
+    // gather the frame into one buffer and hand that to every output with
+    // a single write
+    BYTE* dst = out.pack;
+    for (int i = 0; i < n; i++) {
+        memcpy(dst, out.spans[i].data, out.spans[i].len);
+        dst += out.spans[i].len;
+    }
+    for (int i = 0; i < out.count; i++) {
+        const BYTE* src = out.pack + (out.y4m_headers[i] ? 0 : frame_header_len);
+        if (write_all(out.fd[i], src, dst - src))
+            wrote += out.frame_size;
+    }
+    if (wrote != out.count*out.frame_size) {
+        fprintf_s(stderr, "Output error: wrote only %d of %d bytes\n", wrote, out.count*out.frame_size);
+        return false;
+    }
+    out.written++;
+    return true;
+}
+
+static bool is_regular_file(int fd) {
+    return GetFileType((HANDLE)_get_osfhandle(fd)) == FILE_TYPE_DISK;
+}
+
+// Reserves clusters for size bytes without moving the end of file, so a run
+// that dies never leaves a file longer than what was written to it. Writes
+// past the valid data length still make NTFS zero the gap below them, which
+// with -jobs is at most the runs the other jobs are ahead by. SetFileValidData()
+// would skip that, but it needs SeManageVolumePrivilege and exposes whatever
+// was on the disk in frames that never get written.
+static bool reserve_file(int fd, __int64 size) {
+    FILE_ALLOCATION_INFO fai;
+    fai.AllocationSize.QuadPart = size;
+    return !!SetFileInformationByHandle((HANDLE)_get_osfhandle(fd), FileAllocationInfo, &fai, sizeof(fai));
+}
+
+// cuts the file behind fd down to size bytes if it's longer
+static void truncate_file(int fd, __int64 size) {
+    HANDLE h = (HANDLE)_get_osfhandle(fd);
+    LARGE_INTEGER cur;
+    if (!GetFileSizeEx(h, &cur) || cur.QuadPart <= size)
+        return;
+    FILE_END_OF_FILE_INFO eof;
+    eof.EndOfFile.QuadPart = size;
+    SetFileInformationByHandle(h, FileEndOfFileInfo, &eof, sizeof(eof));
+}
+
+static __int64 record_size(const Outputs& out, int i) {
+    return out.frame_size + (out.y4m_headers[i] ? frame_header_len : 0);
+}
+
+bool preallocate_outputs(Outputs& out, int frames) {
+    bool all = out.count > 0;
+    for (int i = 0; i < out.count; i++) {
+        if (!is_regular_file(out.fd[i])) {
+            all = false;
+            continue;
+        }
+        out.base[i] = lseek64(out.fd[i], 0, SEEK_CUR);
+        if (out.base[i] < 0) {
+            all = false;
+            continue;
+        }
+        // only an optimization: writes at any offset work without it
+        reserve_file(out.fd[i], out.base[i] + record_size(out, i)*frames);
+        out.positional[i] = true;
+    }
+    return all;
+}
+
+// write() at a given offset. This moves the file pointer too, but once frames
+// go out by offset nothing uses it.
+static bool write_all_at(int fd, const BYTE* data, size_t len, __int64 offset) {
+    HANDLE h = (HANDLE)_get_osfhandle(fd);
+    while (len) {
+        OVERLAPPED ov = {};
+        ov.Offset = (DWORD)offset;
+        ov.OffsetHigh = (DWORD)(offset >> 32);
+        DWORD n;
+        if (!WriteFile(h, data, (DWORD)min(len, (size_t)1<<30), &n, &ov) || !n)
+            return false;
+        data += n;
+        len -= n;
+        offset += n;
+    }
+    return true;
+}
+
+bool write_frame_at(const BYTE* buf, int index, const Outputs& out) {
+    for (int i = 0; i < out.count; i++) {
+        __int64 offset = out.base[i] + record_size(out, i)*index;
+        if (out.y4m_headers[i]) {
+            if (!write_all_at(out.fd[i], (const BYTE*)frame_header, frame_header_len, offset))
+                goto fail;
+            offset += frame_header_len;
+        }
+        if (!write_all_at(out.fd[i], buf, out.frame_size, offset))
+            goto fail;
+    }
+    return true;
+fail:
+    fprintf_s(stderr, "Output error: couldn't write frame %d\n", index);
+    return false;
+}
+
+void trim_outputs(const Outputs& out) {
+    for (int i = 0; i < out.count; i++)
+        if (out.positional[i])
+            truncate_file(out.fd[i], out.base[i] + record_size(out, i)*out.written);
+}
+
+FramePlanes packed_planes(const BYTE* buf, const Outputs& out) {
+    FramePlanes fp;
+    for (int p = 0; p < 3; p++) {
+        fp.data[p] = buf;
+        fp.pitch[p] = plane_width(out, p);
+        buf += plane_width(out, p) * plane_height(out, p);
+    }
+    return fp;
+}
+
+void pack_frame(const PVideoFrame& f, const Outputs& out, BYTE* dst) {
+    if (out.yuy2) {
+        FramePlanes fp = packed_planes(dst, out);
+        const BYTE* src = f->GetReadPtr();
+        for (int y = 0; y < out.height; y++) {
+            deinterleave_yuy2(src, (BYTE*)fp.data[0] + y*fp.pitch[0], (BYTE*)fp.data[1] + y*fp.pitch[1],
+                              (BYTE*)fp.data[2] + y*fp.pitch[2], out.width);
+            src += f->GetPitch();
+        }
+        return;
+    }
+    for (int p = 0; p < 3; p++) {
+        int w = plane_width(out, p);
+        int h = plane_height(out, p);
+        int pitch = f->GetPitch(planes[p]);
+        const BYTE* src = f->GetReadPtr(planes[p]);
+        if (pitch == w) {
+            memcpy(dst, src, (size_t)w * h);
+            dst += w * h;
+            continue;
+        }
+        for (int y = 0; y < h; y++) {
+            memcpy(dst, src, w);
+            dst += w;
+            src += pitch;
+        }
+    }
+}
@@ -0,0 +1,87 @@
+// Avs2YUV by Loren Merritt
+
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+
+#ifndef __Output_H__
+#define __Output_H__
+
+#include <vector>
+#include "internal.h"
+
+#define MAX_FH 10
+
+// a run of bytes that goes out in one piece: the FRAME header, a whole plane
+// when its pitch equals its width, or a single row otherwise
+struct Span {
+    const BYTE* data;
+    size_t      len;
+};
+
+// where the Y/U/V planes of a frame are, either inside a PVideoFrame or in a
+// buffer filled by pack_frame()
+struct FramePlanes {
+    const BYTE* data[3];
+    int         pitch[3];
+};
+
+struct Outputs {
+    FILE*       fh[MAX_FH];
+    int         fd[MAX_FH];
+    int         y4m_headers[MAX_FH];
+    int         count;
+    int         width;
+    int         height;
+    bool        yuy2;         // source frames are packed YUY2, written as planar 4:2:2
+    int         chroma_h_shift;
+    int         frame_size;   // bytes of pixel data per frame
+    BYTE*       pack;         // FRAME header + contiguous copy of the planes
+    std::vector<Span> spans;
+    std::vector<BYTE> planar; // a deinterleaved YUY2 frame
+    FILE*       hash_fh;      // -hash manifest, one line of plane checksums per frame
+    // regular files whose final size is known get preallocated, and can then
+    // take frames at computed offsets in any order
+    bool        positional[MAX_FH];
+    __int64     base[MAX_FH]; // offset of the first frame, i.e. the stream header length
+    int         written;      // frames written so far; with -jobs, the frames before the first gap
+};
+
+static inline bool any_outputs(const Outputs& out) {
+    return out.count || out.hash_fh;
+}
+
+// Frames are written straight to the file descriptors behind fh[], so any
+// stdio output (the stream headers) has to be flushed before the first frame.
+//
+// vi has to be YV12 or YUY2; YUY2 is split into planes on the way out.
+void init_outputs(Outputs& out, const VideoInfo& vi);
+void free_outputs(Outputs& out);
+bool write_frame(const PVideoFrame& f, int frm, Outputs& out);
+bool write_frame(const FramePlanes& f, int frm, Outputs& out);
+
+// Reserves the space for frames frames in every regular file output, without
+// changing their length. Returns true if every output (and there is at least
+// one) can take write_frame_at().
+bool preallocate_outputs(Outputs& out, int frames);
+// Writes a packed frame as frame number index of the stream. Unlike
+// write_frame() this may be called from several threads at once.
+bool write_frame_at(const BYTE* buf, int index, const Outputs& out);
+// Cuts preallocated files back to the out.written frames actually written, so
+// that a failed run leaves no holes or partial frames at the end.
+void trim_outputs(const Outputs& out);
+
+// trims the outputs when it goes out of scope, however the run ends
+class TrimOutputs {
+    const Outputs& out;
+public:
+    TrimOutputs(const Outputs& _out) : out(_out) {}
+    ~TrimOutputs() { trim_outputs(out); }
+};
+
+// a packed frame is the planes back to back without padding, out.frame_size bytes
+FramePlanes packed_planes(const BYTE* buf, const Outputs& out);
+void pack_frame(const PVideoFrame& f, const Outputs& out, BYTE* dst);
+
+#endif // __Output_H__
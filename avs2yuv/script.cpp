@@ -0,0 +1,339 @@
+// Avs2YUV by Loren Merritt
+
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+
+#include <string>
+#include <vector>
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+#include "script.h"
+
+bool names_equal(const char* a, const char* b) {
+    while (*a && tolower((unsigned char)*a) == tolower((unsigned char)*b))
+        a++, b++;
+    return tolower((unsigned char)*a) == tolower((unsigned char)*b);
+}
+
+// Statements are evaluated as they're parsed; there's no syntax tree.
+class Parser {
+    enum Token { T_END, T_NEWLINE, T_IDENT, T_INT, T_FLOAT, T_STRING, T_PUNCT };
+
+    IScriptEnvironment* env;
+    const char* name;
+    const char* p;
+    int         line;
+
+    Token       tok;
+    int         tok_line;
+    std::string text;       // identifier or string contents
+    int         ival;
+    double      fval;
+    char        punct;
+
+    __declspec(noreturn) void error(const char* msg, const char* arg = NULL) {
+        if (arg)
+            env->ThrowError("Script error: %s\"%s\"\n(%s, line %d)", msg, arg, name, tok_line);
+        env->ThrowError("Script error: %s\n(%s, line %d)", msg, name, tok_line);
+    }
+
+    void skip_blanks() {
+        for (;;) {
+            if (*p == ' ' || *p == '\t' || *p == '\r') {
+                p++;
+            } else if (*p == '#') {
+                while (*p && *p != '\n')
+                    p++;
+            } else if (p[0] == '/' && p[1] == '*') {
+                const char* end = strstr(p+2, "*/");
+                if (!end)
+                    error("unterminated comment");
+                for (; p < end; p++)
+                    if (*p == '\n')
+                        line++;
+                p = end + 2;
+            } else if (*p == '\\') {
+                // continues on the next line
+                const char* q = p+1;
+                while (*q == ' ' || *q == '\t' || *q == '\r')
+                    q++;
+                if (*q == '#')
+                    while (*q && *q != '\n')
+                        q++;
+                if (*q != '\n' && *q)
+                    error("unexpected \\");
+                p = *q ? q+1 : q;
+                line++;
+            } else {
+                return;
+            }
+        }
+    }
+
+    // a line whose first non-blank character is \ continues the previous one
+    bool continues_line(const char* q) {
+        while (*q == ' ' || *q == '\t' || *q == '\r')
+            q++;
+        return *q == '\\';
+    }
+
+    void next() {
+        skip_blanks();
+        const char* start = p;
+        tok_line = line;
+        if (!*p) {
+            tok = T_END;
+        } else if (*p == '\n') {
+            p++;
+            line++;
+            if (continues_line(p)) {
+                while (*p != '\\')
+                    p++;
+                p++;
+                next();
+                return;
+            }
+            tok = T_NEWLINE;
+        } else if (isalpha((unsigned char)*p) || *p == '_') {
+            while (isalnum((unsigned char)*p) || *p == '_')
+                p++;
+            tok = T_IDENT;
+            text.assign(start, p);
+        } else if (isdigit((unsigned char)*p) || (*p == '.' && isdigit((unsigned char)p[1]))) {
+            while (isdigit((unsigned char)*p))
+                p++;
+            if (*p == '.' && isdigit((unsigned char)p[1])) {
+                p++;
+                while (isdigit((unsigned char)*p))
+                    p++;
+                tok = T_FLOAT;
+                fval = strtod(start, NULL);
+            } else {
+                tok = T_INT;
+                ival = atoi(start);
+            }
+        } else if (*p == '$') {
+            char* end;
+            ival = (int)strtoul(p+1, &end, 16);
+            if (end == p+1)
+                error("expected hex digits after $");
+            p = end;
+            tok = T_INT;
+        } else if (!strncmp(p, "\"\"\"", 3)) {
+            const char* end = strstr(p+3, "\"\"\"");
+            if (!end)
+                error("unterminated string");
+            text.assign(p+3, end);
+            for (const char* q = p; q < end; q++)
+                if (*q == '\n')
+                    line++;
+            p = end + 3;
+            tok = T_STRING;
+        } else if (*p == '"') {
+            const char* end = strchr(p+1, '"');
+            if (!end || memchr(p+1, '\n', end-p-1))
+                error("unterminated string");
+            text.assign(p+1, end);
+            p = end + 1;
+            tok = T_STRING;
+        } else if (strchr("=.,()-", *p)) {
+            punct = *p++;
+            tok = T_PUNCT;
+        } else {
+            char c[2] = { *p, 0 };
+            error("unexpected character ", c);
+        }
+    }
+
+    bool is_punct(char c) {
+        return tok == T_PUNCT && punct == c;
+    }
+
+    // the identifier just read is followed by a single =
+    bool assignment_follows() {
+        const char* q = p;
+        while (*q == ' ' || *q == '\t')
+            q++;
+        return q[0] == '=' && q[1] != '=';
+    }
+
+    void skip_newlines() {
+        while (tok == T_NEWLINE)
+            next();
+    }
+
+    AVSValue call(const std::string& func, std::vector<AVSValue>& args, std::vector<const char*>& names, bool oop) {
+        if (!env->FunctionExists(func.c_str()))
+            error("there is no function named ", func.c_str());
+        try {
+            return env->Invoke(func.c_str(), AVSValue(args.data(), (int)args.size()), names.data());
+        } catch (const IScriptEnvironment::NotFound&) {}
+        // retry with the implicit last, unless the clip came before the dot
+        if (!oop) {
+            try {
+                args.insert(args.begin(), env->GetVar("last"));
+                names.insert(names.begin(), (const char*)NULL);
+                return env->Invoke(func.c_str(), AVSValue(args.data(), (int)args.size()), names.data());
+            } catch (const IScriptEnvironment::NotFound&) {}
+        }
+        error("invalid arguments to function ", func.c_str());
+    }
+
+    // after the opening parenthesis
+    void arguments(std::vector<AVSValue>& args, std::vector<const char*>& names) {
+        next();
+        skip_newlines();
+        if (is_punct(')')) {
+            next();
+            return;
+        }
+        for (;;) {
+            const char* arg_name = NULL;
+            if (tok == T_IDENT && assignment_follows()) {
+                arg_name = env->SaveString(text.c_str());
+                next();
+                next();
+            }
+            args.push_back(expression());
+            names.push_back(arg_name);
+            skip_newlines();
+            if (is_punct(')'))
+                break;
+            if (!is_punct(','))
+                error("expected , or ) in argument list");
+            next();
+            skip_newlines();
+        }
+        next();
+    }
+
+    AVSValue primary() {
+        AVSValue v;
+        bool negative = false;
+        if (is_punct('-')) {
+            negative = true;
+            next();
+            if (tok != T_INT && tok != T_FLOAT)
+                error("only numbers can be negated");
+        }
+        switch (tok) {
+        case T_INT:
+            v = negative ? -ival : ival;
+            next();
+            return v;
+        case T_FLOAT:
+            v = (float)(negative ? -fval : fval);
+            next();
+            return v;
+        case T_STRING:
+            v = env->SaveString(text.c_str());
+            next();
+            return v;
+        case T_PUNCT:
+            if (punct == '(') {
+                next();
+                v = expression();
+                if (!is_punct(')'))
+                    error("expected )");
+                next();
+                return v;
+            }
+            break;
+        case T_IDENT: {
+            std::string ident = text;
+            next();
+            if (names_equal(ident.c_str(), "true") || names_equal(ident.c_str(), "yes"))
+                return true;
+            if (names_equal(ident.c_str(), "false") || names_equal(ident.c_str(), "no"))
+                return false;
+            std::vector<AVSValue> args;
+            std::vector<const char*> names;
+            if (is_punct('(')) {
+                arguments(args, names);
+                return call(ident, args, names, false);
+            }
+            try {
+                return env->GetVar(ident.c_str());
+            } catch (const IScriptEnvironment::NotFound&) {}
+            return call(ident, args, names, false);
+        }
+        default:
+            break;
+        }
+        error("expected a value");
+    }
+
+    AVSValue expression() {
+        AVSValue v = primary();
+        while (is_punct('.')) {
+            next();
+            if (tok != T_IDENT)
+                error("expected a function name after .");
+            std::string func = text;
+            next();
+            std::vector<AVSValue> args(1, v);
+            std::vector<const char*> names(1, (const char*)NULL);
+            if (is_punct('('))
+                arguments(args, names);
+            v = call(func, args, names, true);
+        }
+        return v;
+    }
+
+public:
+    Parser(const char* _text, const char* _name, IScriptEnvironment* _env)
+        : env(_env), name(_name), p(_text), line(1), tok_line(1) {}
+
+    AVSValue run() {
+        AVSValue result;
+        bool have_result = false;
+        next();
+        while (tok != T_END) {
+            if (tok == T_NEWLINE) {
+                next();
+                continue;
+            }
+            bool global = false;
+            if (tok == T_IDENT && names_equal(text.c_str(), "return") && !assignment_follows()) {
+                next();
+                return expression();
+            }
+            if (tok == T_IDENT && names_equal(text.c_str(), "global") && !assignment_follows()) {
+                next();
+                if (tok != T_IDENT || !assignment_follows())
+                    error("expected an assignment after global");
+                global = true;
+            }
+            if (tok == T_IDENT && assignment_follows()) {
+                const char* var = env->SaveString(text.c_str());
+                next();
+                next();
+                AVSValue v = expression();
+                if (global)
+                    env->SetGlobalVar(var, v);
+                else
+                    env->SetVar(var, v);
+            } else {
+                result = expression();
+                have_result = true;
+                if (result.IsClip())
+                    env->SetVar("last", result);
+            }
+            if (tok != T_NEWLINE && tok != T_END)
+                error("expected the end of the line");
+        }
+        if (!have_result) {
+            try {
+                result = env->GetVar("last");
+            } catch (const IScriptEnvironment::NotFound&) {}
+        }
+        return result;
+    }
+};
+
+AVSValue eval_script(const char* text, const char* name, IScriptEnvironment* env) {
+    return Parser(text, name, env).run();
+}
@@ -0,0 +1,28 @@
+// Avs2YUV by Loren Merritt
+
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+
+#ifndef __Script_H__
+#define __Script_H__
+
+#include "internal.h"
+
+// Runs a script for the native host. Only the plain filter-chain subset of
+// the language is understood:
+//   x = expr, global x = expr, return expr, and bare expressions, which set last
+//   function calls with positional and name=value arguments, with or without
+//   parentheses, and clip.Function(...) chaining; last is supplied implicitly
+//   int, float, "string", """string""" and true/false/yes/no literals
+//   # and /* */ comments, and \ continuing a line at its start or end
+// Arithmetic, conditionals and user-defined functions are not supported.
+// The value is that of the return statement, or else of the last bare
+// expression, or else last. name is only used in error messages.
+AVSValue eval_script(const char* text, const char* name, IScriptEnvironment* env);
+
+// case-insensitive, like all names in scripts
+bool names_equal(const char* a, const char* b);
+
+#endif // __Script_H__
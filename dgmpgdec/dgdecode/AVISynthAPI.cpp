@@ -30,10 +30,11 @@
 #include "AvisynthAPI.h"
 #include "utilities.h"
 #include <string.h>
+#include <emmintrin.h>
 
 #define VERSION "DGDecode 1.5.8"
 
-MPEG2Source::MPEG2Source(const char* d2v, int cpu, int idct, int iPP, int moderate_h, int moderate_v, bool showQ, bool fastMC, const char* _cpu2, int _info, int _upConv, bool _i420, int iCC, IScriptEnvironment* env)
+MPEG2Source::MPEG2Source(const char* d2v, int cpu, int idct, int iPP, int moderate_h, int moderate_v, bool showQ, bool fastMC, const char* _cpu2, int _info, int _upConv, bool _i420, int iCC, int cache, int threads, int gops, IScriptEnvironment* env)
 {
 	int status;
 
@@ -57,6 +58,15 @@ MPEG2Source::MPEG2Source(const char* d2v, int cpu, int idct, int iPP, int modera
 	if (_upConv != 0 && _upConv != 1 && _upConv != 2)
 		env->ThrowError("MPEG2Source: upConv must be set to 0, 1, or 2!");
 
+	if (cache < 0)
+		env->ThrowError("MPEG2Source: cache must be 0 or more (megabytes)!");
+
+	if (threads < 0 || threads > MAX_SLICE_THREADS)
+		env->ThrowError("MPEG2Source: threads must be from 0 to %d!", MAX_SLICE_THREADS);
+
+	if (gops < 0 || gops > MAX_GOP_THREADS)
+		env->ThrowError("MPEG2Source: gops must be from 0 to %d!", MAX_GOP_THREADS);
+
 	ovr_idct = idct;
 	m_decoder.iPP = iPP;
 	m_decoder.iCC = iCC;
@@ -68,6 +78,12 @@ MPEG2Source::MPEG2Source(const char* d2v, int cpu, int idct, int iPP, int modera
 	m_decoder.moderate_h = moderate_h;
 	m_decoder.moderate_v = moderate_v;
 	m_decoder.maxquant = m_decoder.minquant = m_decoder.avgquant = 0;
+	// The info overlay shows statistics of the last decoded picture, which a
+	// cached frame doesn't update.
+	m_decoder.cache_mb = _info ? 0 : cache;
+	m_decoder.threads = threads;
+	// The info overlay would be of another decoder's picture.
+	m_decoder.gops = _info ? 0 : gops;
 
 	if (ovr_idct > 7) 
 	{
@@ -171,15 +187,6 @@ MPEG2Source::MPEG2Source(const char* d2v, int cpu, int idct, int iPP, int modera
 		if (bufY == NULL || bufU == NULL || bufV == NULL)
 			env->ThrowError("MPEG2Source:  malloc failure (bufY, bufU, bufV)!");
 	}
-
-	u444 = v444 = NULL;
-	if (_upConv == 2)
-	{
-		u444 = (unsigned char*)aligned_malloc(vi.width*vi.height+2048,32);
-		v444 = (unsigned char*)aligned_malloc(vi.width*vi.height+2048,32);
-		if (u444 == NULL || v444 == NULL)
-			env->ThrowError("MPEG2Source:  malloc failure (u444, v444)!");
-	}
 }
 
 MPEG2Source::~MPEG2Source()
@@ -189,8 +196,6 @@ MPEG2Source::~MPEG2Source()
 	if (bufY != NULL) { aligned_free(bufY); bufY = NULL; }
 	if (bufU != NULL) { aligned_free(bufU); bufU = NULL; }
 	if (bufV != NULL) { aligned_free(bufV); bufV = NULL; }
-	if (u444 != NULL) { aligned_free(u444); u444 = NULL; }
-	if (v444 != NULL) { aligned_free(v444); v444 = NULL; }
 }
 
 bool __stdcall MPEG2Source::GetParity(int)
@@ -233,7 +238,7 @@ void MPEG2Source::override(int ovr_idct)
 			break;
 
 		case IDCT_SSE2MMX:
-			m_decoder.idctFunc = SSE2MMX_IDCT;
+			m_decoder.idctFunc = SSE2_IDCT;
 			if (!cpu.sse2mmx)
 			{
 				m_decoder.IDCT_Flag = IDCT_SSEMMX;
@@ -278,13 +283,7 @@ PVideoFrame __stdcall MPEG2Source::GetFrame(int n, IScriptEnvironment* env)
 		raw = max(m_decoder.FrameList[n].bottom, m_decoder.FrameList[n].top);
 		if (raw < (int)m_decoder.BadStartingFrames) raw = m_decoder.BadStartingFrames;
 
-		for (gop = 0; gop < (int) m_decoder.VF_GOPLimit - 1; gop++)
-		{
-			if (raw >= (int)m_decoder.GOPList[gop]->number && raw < (int)m_decoder.GOPList[gop+1]->number)
-			{
-				break;
-			}
-		}
+		gop = m_decoder.GetGOP(raw);
 	}
 
     PVideoFrame frame = env->NewVideoFrame(vi);
@@ -340,16 +339,11 @@ PVideoFrame __stdcall MPEG2Source::GetFrame(int n, IScriptEnvironment* env)
 			frame->GetPitch(),vi.width,vi.height);
 	}
 
-	if (m_decoder.upConv == 2) // convert 4:2:2 (planar) to 4:4:4 (planar) and then to RGB24
+	if (m_decoder.upConv == 2) // convert 4:2:2 (planar) to RGB24, written bottom-up
 	{
-		conv422to444(out->u,u444,out->uvpitch,vi.width,vi.width,vi.height);
-		conv422to444(out->v,v444,out->uvpitch,vi.width,vi.width,vi.height);
-		PVideoFrame frame2 = env->NewVideoFrame(vi);
-		conv444toRGB24(out->y,u444,v444,frame2->GetWritePtr(),out->ypitch,vi.width,
-			frame2->GetPitch(),vi.width,vi.height,m_decoder.GOPList[gop]->matrix,m_decoder.pc_scale);
-		env->BitBlt(frame->GetWritePtr(), frame->GetPitch(), 
-			frame2->GetReadPtr() + (vi.height-1) * frame2->GetPitch(), -frame2->GetPitch(), 
-			frame->GetRowSize(), frame->GetHeight());
+		conv422toRGB24(out->y,out->u,out->v,frame->GetWritePtr() + (vi.height-1) * frame->GetPitch(),
+			out->ypitch,out->uvpitch,-frame->GetPitch(),vi.width,vi.height,
+			m_decoder.GOPList[gop]->matrix,m_decoder.pc_scale);
 	}
 
 	if (m_decoder.info != 0)
@@ -465,13 +459,7 @@ int MPEG2Source::getMatrix(int n)
 	int raw = max(m_decoder.FrameList[n].bottom, m_decoder.FrameList[n].top);
 	if (raw < (int)m_decoder.BadStartingFrames) raw = m_decoder.BadStartingFrames;
 
-	for (int gop = 0; gop < (int) m_decoder.VF_GOPLimit - 1; gop++)
-	{
-		if (raw >= (int)m_decoder.GOPList[gop]->number && 
-			raw < (int)m_decoder.GOPList[gop+1]->number) 
-			return m_decoder.GOPList[gop]->matrix;
-	}
-	return 1;
+	return m_decoder.GOPList[m_decoder.GetGOP(raw)]->matrix;
 }
 
 /*
@@ -486,15 +474,12 @@ int MPEG2Source::getMatrix(int n)
 // lots of bug fixes and new isse 422->444 routine
 // tritical - August 18, 2005
 
-static const __int64 mmmask_0001 = 0x0001000100010001;
 static const __int64 mmmask_0002 = 0x0002000200020002;
 static const __int64 mmmask_0003 = 0x0003000300030003;
 static const __int64 mmmask_0004 = 0x0004000400040004;
 static const __int64 mmmask_0005 = 0x0005000500050005;
 static const __int64 mmmask_0007 = 0x0007000700070007;
 static const __int64 mmmask_0016 = 0x0010001000100010;
-static const __int64 mmmask_0128 = 0x0080008000800080;
-static const __int64 lastmask    = 0xFF00000000000000;
 static const __int64 mmmask_0101 = 0x0101010101010101;
 
 void conv420to422(const unsigned char *src, unsigned char *dst, int frame_type, int src_pitch,
@@ -870,357 +855,188 @@ convyuv422bottomp:
 	}
 }
 
-void conv422to444(const unsigned char *src, unsigned char *dst, int src_pitch, int dst_pitch, 
-			int width, int height)
+// Converts 4:2:2 planar straight to RGB24 in one pass, the 4:4:4 chroma is
+// interpolated in registers instead of being written to and read back from
+// two full size planes. The output is the same as that of
+// the MMX conversion through 4:4:4 planes it replaces. dst_pitch may be
+// negative for bottom-up frames. Without SSE2 each pixel is done in C.
+// In 13 bit fixed point:
+//   R = ((Y-off)*scale + (V-128)*crv + 4096) >> 13
+//   G = ((Y-off)*scale + (V-128)*cgv + (U-128)*cgu + 4096) >> 13
+//   B = ((Y-off)*scale + (U-128)*cbu + 4096) >> 13
+
+static __forceinline int clamp255(int x)
 {
-	if (cpu.ssemmx)
-	{
-		conv422to444_iSSE(src, dst, src_pitch, dst_pitch, width, height);
-		return;
-	}
-
-	int HALF_WIDTH_D8 = (width>>1)-8;
-	
-	__asm
-	{
-		mov			eax, [src]	// eax = src
-		mov			ebx, [dst]	// ebx = dst
-		mov			edi, height	// edi = height
-		mov			ecx, HALF_WIDTH_D8	// ecx = (width>>1)-8
-		movq		mm1, mmmask_0001	// mm1 = 1's
-		pxor		mm0, mm0	// mm0 = 0's
-
-convyuv444init:
-		movq		mm7, [eax]  // mm7 = hgfedcba
-		xor			esi, esi	// esi = 0
-
-convyuv444:
-		movq		mm2, mm7    // mm2 = hgfedcba
-		movq		mm7, [eax+esi+8] // mm7 = ponmlkji
-		movq		mm3, mm2    // mm3 = hgfedcba
-		movq		mm4, mm7    // mm4 = ponmlkji
-
-		psrlq		mm3, 8      // mm3 = 0hgfedcb
-		psllq		mm4, 56     // mm4 = i0000000
-		por			mm3, mm4    // mm3 = ihgfedcb 
-
-		movq		mm4, mm2    // mm4 = hgfedcba
-		movq		mm5, mm3    // mm5 = ihgfedcb
-
-		punpcklbw	mm4, mm0    // 0d0c0b0a
-		punpcklbw	mm5, mm0    // 0e0d0c0b
-
-		movq		mm6, mm4    // mm6 = 0d0c0b0a
-		paddusw		mm4, mm1
-		paddusw		mm4, mm5
-		psrlw		mm4, 1		// average mm4/mm5 (d/e,c/d,b/c,a/b)	
-		psllq		mm4, 8		// mm4 = z0z0z0z0
-		por			mm4, mm6	// mm4 = zdzczbza
-
-		punpckhbw	mm2, mm0	// 0h0g0f0e
-		punpckhbw	mm3, mm0	// 0i0h0g0f
-
-		movq		mm6, mm2	// mm6 = 0h0g0f0e
-		paddusw		mm2, mm1
-		paddusw		mm2, mm3
-		psrlw		mm2, 1		// average mm2/mm3 (h/i,g/h,f/g,e/f)
-		psllq		mm2, 8		// mm2 = z0z0z0z0
-		por			mm2, mm6	// mm2 = zhzgzfze
-
-		movq		[ebx+esi*2], mm4	// store zdzczbza
-		movq		[ebx+esi*2+8], mm2	// store zhzgzfze
-
-		add			esi, 8
-		cmp			esi, ecx
-		jl			convyuv444	// loop back if not to last 8 pixels
-
-		movq		mm2, mm7	// mm2 = ponmlkji
-
-		punpcklbw	mm2, mm0	// mm2 = 0l0k0j0i
-		punpckhbw	mm7, mm0	// mm7 = 0p0o0n0m
-
-		movq		mm3, mm2	// mm3 = 0l0k0j0i
-		movq		mm4, mm7	// mm4 = 0p0o0n0m
-
-		psrlq		mm2, 16		// mm2 = 000l0k0j
-		psllq		mm4, 48		// mm4 = 0m000000
-		por			mm2, mm4	// mm2 = 0m0l0k0j
-
-		paddusw		mm2, mm1
-		paddusw		mm2, mm3
-		psrlw		mm2, 1		// average mm2/mm3 (m/l,l/k,k/j,j/i)	
-		psllq		mm2, 8		// mm2 = z0z0z0z0
-		por			mm2, mm3	// mm2 = zlzkzjzi
-
-		movq		mm6, mm7	// mm6 = 0p0o0n0m
-		movq		mm4, mm7	// mm4 = 0p0o0n0m
-
-		psrlq		mm6, 48		// mm6 = 0000000p
-		psrlq		mm4, 16		// mm4 = 000p0o0n
-		psllq		mm6, 48		// mm6 = 0p000000
-		por			mm4,mm6		// mm4 = 0p0p0o0n
-
-		paddusw		mm4, mm1
-		paddusw		mm4, mm7
-		psrlw		mm4, 1		// average mm4/mm7 (p/p,p/o,o/n,n/m)	
-		psllq		mm4, 8		// mm4 = z0z0z0z0
-		por			mm4, mm7	// mm4 = zpzoznzm
-
-		movq		[ebx+esi*2], mm2	// store mm2
-		movq		[ebx+esi*2+8], mm4	// store mm4	
-
-		add			eax, src_pitch
-		add			ebx, dst_pitch
-		dec			edi
-		jnz			convyuv444init
-
-		emms
-	}
+	return x < 0 ? 0 : x > 255 ? 255 : x;
 }
 
-void conv422to444_iSSE(const unsigned char *src, unsigned char *dst, int src_pitch, int dst_pitch, 
-			int width, int height)
+// 4 pixels of BGR0 to 12 bytes of BGR
+static __forceinline __m128i pack_bgr4(__m128i p)
 {
-	int HALF_WIDTH_D8 = (width>>1)-8;
-	
-	__asm
-	{
-		mov			eax, [src]	// eax = src
-		mov			ebx, [dst]	// ebx = dst
-		mov			edi, height	// edi = height
-		mov			ecx, HALF_WIDTH_D8	// ecx = (width>>1)-8
-		mov			edx, src_pitch
-		xor			esi, esi	// esi = 0
-		movq		mm7, lastmask
-
-xloop:
-		movq		mm0, [eax+esi]  // mm7 = hgfedcba
-		movq		mm1, [eax+esi+1]// mm1 = ihgfedcb
-		pavgb		mm1, mm0
-		movq		mm2, mm0
-		punpcklbw	mm0,mm1
-		punpckhbw	mm2,mm1
-
-		movq		[ebx+esi*2], mm0	// store mm0
-		movq		[ebx+esi*2+8], mm2	// store mm2
-
-		add			esi, 8
-		cmp			esi, ecx
-		jl			xloop	// loop back if not to last 8 pixels
-
-		movq		mm0, [eax+esi]  // mm7 = hgfedcba
-		movq		mm1, mm0		// mm1 = hgfedcba
-		movq		mm2, mm0		// mm2 = hgfedcba
-		psrlq		mm1, 8			// mm1 = 0hgfedcb
-		pand		mm2, mm7		// mm2 = h0000000
-		por			mm1, mm2		// mm1 = hhgfedcb
-		pavgb		mm1, mm0
-		movq		mm2, mm0
-		punpcklbw	mm0,mm1
-		punpckhbw	mm2,mm1
+	const __m128i m0 = _mm_set_epi32(0, 0x00FFFFFF, 0, 0x00FFFFFF);
+	const __m128i m1 = _mm_set_epi32(0x0000FFFF, 0xFF000000, 0x0000FFFF, 0xFF000000);
+	const __m128i m6 = _mm_set_epi32(0, 0, 0x0000FFFF, 0xFFFFFFFF);
 
-		movq		[ebx+esi*2], mm0	// store mm0
-		movq		[ebx+esi*2+8], mm2	// store mm2
-
-		add			eax, edx
-		add			ebx, dst_pitch
-		xor			esi, esi
-		dec			edi
-		jnz			xloop
-		emms
-	}
+	p = _mm_or_si128(_mm_and_si128(p, m0), _mm_and_si128(_mm_srli_epi64(p, 8), m1));
+	return _mm_or_si128(_mm_and_si128(p, m6), _mm_slli_si128(_mm_srli_si128(p, 8), 6));
 }
 
-void conv444toRGB24(const unsigned char *py, const unsigned char *pu, const unsigned char *pv, 
+void conv422toRGB24(const unsigned char *py, const unsigned char *pu, const unsigned char *pv, 
 				unsigned char *dst, int src_pitchY, int src_pitchUV, int dst_pitch, int width, 
 				int height, int matrix, int pc_scale)
 {
-	__int64 RGB_Offset, RGB_Scale, RGB_CBU, RGB_CRV, RGB_CGX;
-	int dst_modulo = dst_pitch-(3*width);
+	int scale, offset, cbu, cgu, cgv, crv;
+	int cw = width >> 1;
 
 	if (pc_scale)
 	{
-		RGB_Scale = 0x1000254310002543;
-		RGB_Offset = 0x0010001000100010;
+		scale = 0x2543;
+		offset = 16;
 		if (matrix == 7) // SMPTE 240M (1987)
 		{
-			RGB_CBU = 0x0000428500004285;
-			RGB_CGX = 0xF7BFEEA3F7BFEEA3;
-			RGB_CRV = 0x0000396900003969;
+			cbu = 0x4285; cgu = -0x0841; cgv = -0x115D; crv = 0x3969;
 		}
 		else if (matrix == 6 || matrix == 5) // SMPTE 170M/ITU-R BT.470-2 -- BT.601
 		{
-			RGB_CBU = 0x0000408D0000408D;
-			RGB_CGX = 0xF377E5FCF377E5FC;
-			RGB_CRV = 0x0000331300003313;
+			cbu = 0x408D; cgu = -0x0C89; cgv = -0x1A04; crv = 0x3313;
 		}
 		else if (matrix == 4) // FCC
 		{
-			RGB_CBU = 0x000040D8000040D8;
-			RGB_CGX = 0xF3E9E611F3E9E611;
-			RGB_CRV = 0x0000330000003300;
+			cbu = 0x40D8; cgu = -0x0C17; cgv = -0x19EF; crv = 0x3300;
 		}
 		else // ITU-R Rec.709 (1990) -- BT.709
 		{
-			RGB_CBU = 0x0000439A0000439A;
-			RGB_CGX = 0xF92CEEF1F92CEEF1;
-			RGB_CRV = 0x0000395F0000395F;
+			cbu = 0x439A; cgu = -0x06D4; cgv = -0x110F; crv = 0x395F;
 		}
 	}
 	else
 	{
-		RGB_Scale = 0x1000200010002000;
-		RGB_Offset = 0x0000000000000000;
+		scale = 0x2000;
+		offset = 0;
 		if (matrix == 7) // SMPTE 240M (1987)
 		{
-			RGB_CBU = 0x00003A6F00003A6F;
-			RGB_CGX = 0xF8C0F0BFF8C0F0BF;
-			RGB_CRV = 0x0000326E0000326E;
+			cbu = 0x3A6F; cgu = -0x0740; cgv = -0x0F41; crv = 0x326E;
 		}
 		else if (matrix == 6 || matrix == 5) // SMPTE 170M/ITU-R BT.470-2 -- BT.601
 		{
-			RGB_CBU = 0x000038B4000038B4;
-			RGB_CGX = 0xF4FDE926F4FDE926;
-			RGB_CRV = 0x00002CDD00002CDD;
+			cbu = 0x38B4; cgu = -0x0B03; cgv = -0x16DA; crv = 0x2CDD;
 		}
 		else if (matrix == 4) // FCC
 		{
-			RGB_CBU = 0x000038F6000038F6;
-			RGB_CGX = 0xF561E938F561E938;
-			RGB_CRV = 0x00002CCD00002CCD;
+			cbu = 0x38F6; cgu = -0x0A9F; cgv = -0x16C8; crv = 0x2CCD;
 		}
 		else // ITU-R Rec.709 (1990) -- BT.709
 		{
-			RGB_CBU = 0x00003B6200003B62;
-			RGB_CGX = 0xFA00F104FA00F104;
-			RGB_CRV = 0x0000326600003266;
+			cbu = 0x3B62; cgu = -0x0600; cgv = -0x0EFC; crv = 0x3266;
 		}
 	}
 
-	__asm
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i c128 = _mm_set1_epi16(128);
+	const __m128i off = _mm_set1_epi16((short)offset);
+	const __m128i one = _mm_set1_epi16(1);
+	const __m128i ys = _mm_set1_epi32((4096 << 16) | scale);
+	const __m128i bu = _mm_set1_epi32(cbu);
+	const __m128i rv = _mm_set1_epi32(crv);
+	const __m128i gvu = _mm_set_epi16(cgu, cgv, cgu, cgv, cgu, cgv, cgu, cgv);
+	const __m128i lastmask = _mm_set_epi32(0, 0, 0xFF000000, 0);
+	int sse2 = cpu.sse2mmx;
+
+	for (int y = 0; y < height; y++)
 	{
-		mov			eax, [py]  // eax = py
-		mov			ebx, [pu]  // ebx = pu
-		mov			ecx, [pv]  // ecx = pv
-		mov			edx, [dst] // edx = dst
-		mov			edi, width // edi = width
-		xor			esi, esi
-		pxor		mm0, mm0
-
-convRGB24:
-		movd		mm1, [eax+esi]
-		movd		mm3, [ebx+esi]
-		punpcklbw	mm1, mm0
-		punpcklbw	mm3, mm0
-		movd		mm5, [ecx+esi]
-		punpcklbw	mm5, mm0
-		movq		mm7, [mmmask_0128]
-		psubw		mm3, mm7
-		psubw		mm5, mm7
-
-		psubw		mm1, RGB_Offset
-		movq		mm2, mm1
-		movq		mm7, [mmmask_0001]
-		punpcklwd	mm1, mm7
-		punpckhwd	mm2, mm7
-		movq		mm7, RGB_Scale
-		pmaddwd		mm1, mm7
-		pmaddwd		mm2, mm7
-
-		movq		mm4, mm3
-		punpcklwd	mm3, mm0
-		punpckhwd	mm4, mm0
-		movq		mm7, RGB_CBU
-		pmaddwd		mm3, mm7
-		pmaddwd		mm4, mm7
-		paddd		mm3, mm1
-		paddd		mm4, mm2
-		psrad		mm3, 13
-		psrad		mm4, 13
-		packuswb	mm3, mm0
-		packuswb	mm4, mm0
-
-		movq		mm6, mm5
-		punpcklwd	mm5, mm0
-		punpckhwd	mm6, mm0
-		movq		mm7, RGB_CRV
-		pmaddwd		mm5, mm7
-		pmaddwd		mm6, mm7
-		paddd		mm5, mm1
-		paddd		mm6, mm2
-		psrad		mm5, 13
-		psrad		mm6, 13
-		packuswb	mm5, mm0
-		packuswb	mm6, mm0
-
-		punpcklbw	mm3, mm5
-		punpcklbw	mm4, mm6
-		movq		mm5, mm3
-		movq		mm6, mm4
-		psrlq		mm5, 16
-		psrlq		mm6, 16
-		por			mm3, mm5
-		por			mm4, mm6
-
-		movd		mm5, [ebx+esi]
-		movd		mm6, [ecx+esi]
-		punpcklbw	mm5, mm0
-		punpcklbw	mm6, mm0
-		movq		mm7, [mmmask_0128]
-		psubw		mm5, mm7
-		psubw		mm6, mm7
+		int x = 0;
 
-		movq		mm7, mm6
-		punpcklwd	mm6, mm5
-		punpckhwd	mm7, mm5		
-		movq		mm5, RGB_CGX
-		pmaddwd		mm6, mm5
-		pmaddwd		mm7, mm5
-		paddd		mm6, mm1
-		paddd		mm7, mm2
-
-		psrad		mm6, 13
-		psrad		mm7, 13
-		packuswb	mm6, mm0
-		packuswb	mm7, mm0
-
-		punpcklbw	mm3, mm6
-		punpcklbw	mm4, mm7
-
-		movq		mm1, mm3
-		movq		mm5, mm4
-		movq		mm6, mm4
-
-		psrlq		mm1, 32
-		psllq		mm1, 24
-		por			mm1, mm3
-
-		psrlq		mm3, 40
-		psllq		mm6, 16
-		por			mm3, mm6
-		movd		[edx], mm1
-
-		psrld		mm4, 16
-		psrlq		mm5, 24
-		por			mm5, mm4
-		movd		[edx+4], mm3
-
-		add			edx, 0x0c
-		add			esi, 0x04
-		cmp			esi, edi
-		movd		[edx-4], mm5
+		if (sse2)
+		{
+			for (; x + 16 <= width; x += 16)
+			{
+				__m128i u, v, un, vn, yy, b[2], g[2], r[2], p[4];
+
+				// chroma of 16 pixels, the odd ones the average of their
+				// neighbours, the last of the line repeats the last sample
+				u = _mm_loadl_epi64((const __m128i *)(pu + (x >> 1)));
+				v = _mm_loadl_epi64((const __m128i *)(pv + (x >> 1)));
+				if (x + 16 < width)
+				{
+					un = _mm_loadl_epi64((const __m128i *)(pu + (x >> 1) + 1));
+					vn = _mm_loadl_epi64((const __m128i *)(pv + (x >> 1) + 1));
+				}
+				else
+				{
+					un = _mm_or_si128(_mm_srli_epi64(u, 8), _mm_and_si128(u, lastmask));
+					vn = _mm_or_si128(_mm_srli_epi64(v, 8), _mm_and_si128(v, lastmask));
+				}
+				u = _mm_unpacklo_epi8(u, _mm_avg_epu8(u, un));
+				v = _mm_unpacklo_epi8(v, _mm_avg_epu8(v, vn));
+				yy = _mm_loadu_si128((const __m128i *)(py + x));
 
-		jl			convRGB24
+				for (int h = 0; h < 2; h++)
+				{
+					__m128i yw, uw, vw, yt, t0, t1, t2, t3;
+
+					yw = _mm_sub_epi16(h ? _mm_unpackhi_epi8(yy, zero) : _mm_unpacklo_epi8(yy, zero), off);
+					uw = _mm_sub_epi16(h ? _mm_unpackhi_epi8(u, zero) : _mm_unpacklo_epi8(u, zero), c128);
+					vw = _mm_sub_epi16(h ? _mm_unpackhi_epi8(v, zero) : _mm_unpacklo_epi8(v, zero), c128);
+
+					yt = _mm_madd_epi16(_mm_unpacklo_epi16(yw, one), ys);
+					t0 = _mm_add_epi32(yt, _mm_madd_epi16(_mm_unpacklo_epi16(uw, zero), bu));
+					t1 = _mm_add_epi32(yt, _mm_madd_epi16(_mm_unpacklo_epi16(vw, zero), rv));
+					t2 = _mm_add_epi32(yt, _mm_madd_epi16(_mm_unpacklo_epi16(vw, uw), gvu));
+					yt = _mm_madd_epi16(_mm_unpackhi_epi16(yw, one), ys);
+					t3 = _mm_add_epi32(yt, _mm_madd_epi16(_mm_unpackhi_epi16(uw, zero), bu));
+					b[h] = _mm_packs_epi32(_mm_srai_epi32(t0, 13), _mm_srai_epi32(t3, 13));
+					t3 = _mm_add_epi32(yt, _mm_madd_epi16(_mm_unpackhi_epi16(vw, zero), rv));
+					r[h] = _mm_packs_epi32(_mm_srai_epi32(t1, 13), _mm_srai_epi32(t3, 13));
+					t3 = _mm_add_epi32(yt, _mm_madd_epi16(_mm_unpackhi_epi16(vw, uw), gvu));
+					g[h] = _mm_packs_epi32(_mm_srai_epi32(t2, 13), _mm_srai_epi32(t3, 13));
+				}
 
-		add			eax, src_pitchY
-		add			ebx, src_pitchUV
-		add			ecx, src_pitchUV
-		add			edx, dst_modulo
-		xor			esi, esi
-		dec			height
-		jnz			convRGB24
+				__m128i bb = _mm_packus_epi16(b[0], b[1]);
+				__m128i gg = _mm_packus_epi16(g[0], g[1]);
+				__m128i rr = _mm_packus_epi16(r[0], r[1]);
+				__m128i bg = _mm_unpacklo_epi8(bb, gg);
+				__m128i r0 = _mm_unpacklo_epi8(rr, zero);
+				p[0] = pack_bgr4(_mm_unpacklo_epi16(bg, r0));
+				p[1] = pack_bgr4(_mm_unpackhi_epi16(bg, r0));
+				bg = _mm_unpackhi_epi8(bb, gg);
+				r0 = _mm_unpackhi_epi8(rr, zero);
+				p[2] = pack_bgr4(_mm_unpacklo_epi16(bg, r0));
+				p[3] = pack_bgr4(_mm_unpackhi_epi16(bg, r0));
+
+				// 48 bytes, nothing past the line
+				_mm_storeu_si128((__m128i *)(dst + 3*x),
+					_mm_or_si128(p[0], _mm_slli_si128(p[1], 12)));
+				_mm_storeu_si128((__m128i *)(dst + 3*x + 16),
+					_mm_or_si128(_mm_srli_si128(p[1], 4), _mm_slli_si128(p[2], 8)));
+				_mm_storeu_si128((__m128i *)(dst + 3*x + 32),
+					_mm_or_si128(_mm_srli_si128(p[2], 8), _mm_slli_si128(p[3], 4)));
+			}
+		}
 
-		emms
+		for (; x < width; x++)
+		{
+			int c = x >> 1, yt, uw, vw;
+
+			uw = pu[c];
+			vw = pv[c];
+			if (x & 1)
+			{
+				int cn = c + 1 < cw ? c + 1 : c;
+				uw = (uw + pu[cn] + 1) >> 1;
+				vw = (vw + pv[cn] + 1) >> 1;
+			}
+			uw -= 128;
+			vw -= 128;
+			yt = (py[x] - offset) * scale + 4096;
+			dst[3*x]   = clamp255((yt + uw * cbu) >> 13);
+			dst[3*x+1] = clamp255((yt + vw * cgv + uw * cgu) >> 13);
+			dst[3*x+2] = clamp255((yt + vw * crv) >> 13);
+		}
+
+		py += src_pitchY;
+		pu += src_pitchUV;
+		pv += src_pitchUV;
+		dst += dst_pitch;
 	}
 }
 
@@ -1632,6 +1448,9 @@ AVSValue __cdecl Create_MPEG2Source(AVSValue args, void*, IScriptEnvironment* en
 	int info = 0;
 	int upConv = 0;
 	bool i420 = false;
+	int cache = 32;
+	int threads = 1;
+	int gops = 0;
 
 	/* Based on D.Graft Msharpen default files code */
 	/* Load user defaults if they exist. */ 
@@ -1684,6 +1503,9 @@ if (strncmp(buf, name, len) == 0) \
 				LOADINT(upConv,"upConv=",7);
 				LOADBOOL(i420,"i420=",5);
 				LOADBOOL(iCC,"iCC=",4);
+				LOADINT(cache,"cache=",6);
+				LOADINT(threads,"threads=",8);
+				LOADINT(gops,"gops=",5);
 			}
 		}
 	}
@@ -1710,6 +1532,9 @@ if (strncmp(buf, name, len) == 0) \
 										args[10].AsInt(upConv),
 										args[11].AsBool(i420),
 										iCC,
+										args[13].AsInt(cache),
+										args[14].AsInt(threads),
+										args[15].AsInt(gops),
 										env );
 		// Only bother invoking crop if we have to.
 		if (dec->m_decoder.Clip_Top    || 
@@ -1771,7 +1596,7 @@ AVSValue __cdecl Create_Deblock(AVSValue args, void* user_data, IScriptEnvironme
 }
 
 extern "C" __declspec(dllexport) const char* __stdcall AvisynthPluginInit2(IScriptEnvironment* env) {
-	env->AddFunction("MPEG2Source", "[d2v]s[cpu]i[idct]i[iPP]b[moderate_h]i[moderate_v]i[showQ]b[fastMC]b[cpu2]s[info]i[upConv]i[i420]b[iCC]b", Create_MPEG2Source, 0);
+	env->AddFunction("MPEG2Source", "[d2v]s[cpu]i[idct]i[iPP]b[moderate_h]i[moderate_v]i[showQ]b[fastMC]b[cpu2]s[info]i[upConv]i[i420]b[iCC]b[cache]i[threads]i[gops]i", Create_MPEG2Source, 0);
 	env->AddFunction("LumaYV12","c[lumoff]i[lumgain]f",Create_LumaYV12,0);
     env->AddFunction("BlindPP", "c[quant]i[cpu]i[cpu2]s[iPP]b[moderate_h]i[moderate_v]i", Create_BlindPP, 0);
     env->AddFunction("Deblock", "c[quant]i[aOffset]i[bOffset]i[mmx]b[isse]b", Create_Deblock, 0);
@@ -1788,12 +1613,12 @@ public:
 	MPEG2Source* vf;
 	VideoInfo pvi;
 	unsigned char *buffer, *picture;
-	unsigned char *u422, *u444, *v422, *v444;
+	unsigned char *u422, *v422;
 	int pitch, vfapi_progressive, ident;
 	NoAVSAccess *prv, *nxt;
 	NoAVSAccess::NoAVSAccess()
 	{
-		buffer = picture = u422 = v422 = u444 = v444 = NULL;
+		buffer = picture = u422 = v422 = NULL;
 		pitch = vfapi_progressive = ident = -1;
 		vf = NULL;
 		nxt = prv = NULL;
@@ -1804,8 +1629,6 @@ public:
 		if (picture) { free(picture); picture = NULL; }
 		if (u422) { free(u422); u422 = NULL; }
 		if (v422) { free(v422); v422 = NULL; }
-		if (u444) { free(u444); u444 = NULL; }
-		if (v444) { free(v444); v444 = NULL; }
 		if (vf) { delete vf; vf = NULL; }
 	}
 	NoAVSAccess::~NoAVSAccess()
@@ -1814,8 +1637,6 @@ public:
 		if (picture) free(picture);
 		if (u422) free(u422);
 		if (v422) free(v422);
-		if (u444) free(u444);
-		if (v444) free(v444);
 		if (vf) delete vf;
 	}
 };
@@ -1910,7 +1731,6 @@ MPEG2Source::MPEG2Source(const char* d2v, int _upConv)
 	vi.SetFieldBased(false);
 
 	bufY = bufU = bufV = NULL;
-	u444 = v444 = NULL;
 
 	out = (YV12PICT*)aligned_malloc(sizeof(YV12PICT),0);
 }
@@ -1974,10 +1794,7 @@ extern "C" __declspec(dllexport) VideoInfo* __cdecl openMPEG2Source(char* file)
 	g_A.picture = (unsigned char*)malloc(g_A.pvi.height * g_A.pvi.width * 3);
 
 	g_A.u422 = (unsigned char*)malloc((g_A.pvi.height * g_A.pvi.width)>>1);
-	g_A.u444 = (unsigned char*)malloc(g_A.pvi.height * g_A.pvi.width);
-
 	g_A.v422 = (unsigned char*)malloc((g_A.pvi.height * g_A.pvi.width)>>1);
-	g_A.v444 = (unsigned char*)malloc(g_A.pvi.height * g_A.pvi.width);
 
 	g_A.pitch = g_A.pvi.width;
 	
@@ -2013,11 +1830,9 @@ extern "C" __declspec(dllexport) unsigned char* __cdecl getRGBFrame(int frame)
 		unsigned char *v = u + ((g_A.pitch * g_A.pvi.height)/4);
 		conv420to422(u, g_A.u422, g_A.vfapi_progressive, g_A.pvi.width>>1, g_A.pvi.width>>1, 
 			g_A.pvi.width, g_A.pvi.height);
-		conv422to444(g_A.u422, g_A.u444, g_A.pvi.width>>1, g_A.pvi.width, g_A.pvi.width, g_A.pvi.height);
 		conv420to422(v, g_A.v422, g_A.vfapi_progressive, g_A.pvi.width>>1, g_A.pvi.width>>1, 
 			g_A.pvi.width, g_A.pvi.height);
-		conv422to444(g_A.v422, g_A.v444, g_A.pvi.width>>1, g_A.pvi.width, g_A.pvi.width, g_A.pvi.height);
-		conv444toRGB24(y, g_A.u444, g_A.v444, g_A.picture, g_A.pvi.width, g_A.pvi.width, 
+		conv422toRGB24(y, g_A.u422, g_A.v422, g_A.picture, g_A.pvi.width, g_A.pvi.width>>1, 
 			g_A.pvi.width * 3, g_A.pvi.width, g_A.pvi.height, g_A.vf->getMatrix(frame), 
 			g_A.vf->m_decoder.pc_scale);
 	}
@@ -2026,9 +1841,7 @@ extern "C" __declspec(dllexport) unsigned char* __cdecl getRGBFrame(int frame)
 		unsigned char *y = g_A.buffer;
 		unsigned char *u = y + (g_A.pitch * g_A.pvi.height);
 		unsigned char *v = u + ((g_A.pitch * g_A.pvi.height)/2);
-		conv422to444(u, g_A.u444, g_A.pvi.width>>1, g_A.pvi.width, g_A.pvi.width, g_A.pvi.height);
-		conv422to444(v, g_A.v444, g_A.pvi.width>>1, g_A.pvi.width, g_A.pvi.width, g_A.pvi.height);
-		conv444toRGB24(y, g_A.u444, g_A.v444, g_A.picture, g_A.pvi.width, g_A.pvi.width, 
+		conv422toRGB24(y, u, v, g_A.picture, g_A.pvi.width, g_A.pvi.width>>1, 
 			g_A.pvi.width * 3, g_A.pvi.width, g_A.pvi.height,  g_A.vf->getMatrix(frame), 
 			g_A.vf->m_decoder.pc_scale);
 	}
@@ -2122,10 +1935,7 @@ extern "C" __declspec(dllexport) VideoInfo* __cdecl openMPEG2SourceMI(char* file
 	j->picture = (unsigned char*)malloc(j->pvi.height * j->pvi.width * 3);
 
 	j->u422 = (unsigned char*)malloc((j->pvi.height * j->pvi.width)>>1);
-	j->u444 = (unsigned char*)malloc(j->pvi.height * j->pvi.width);
-
 	j->v422 = (unsigned char*)malloc((j->pvi.height * j->pvi.width)>>1);
-	j->v444 = (unsigned char*)malloc(j->pvi.height * j->pvi.width);
 
 	j->pitch = j->pvi.width;
 	
@@ -2185,11 +1995,9 @@ extern "C" __declspec(dllexport) unsigned char* __cdecl getRGBFrameMI(int frame,
 		unsigned char *v = u + ((i->pitch * i->pvi.height)/4);
 		conv420to422(u, i->u422, i->vfapi_progressive, i->pvi.width>>1, i->pvi.width>>1, 
 			i->pvi.width, i->pvi.height);
-		conv422to444(i->u422, i->u444, i->pvi.width>>1, i->pvi.width, i->pvi.width, i->pvi.height);
 		conv420to422(v, i->v422, i->vfapi_progressive, i->pvi.width>>1, i->pvi.width>>1, 
 			i->pvi.width, i->pvi.height);
-		conv422to444(i->v422, i->v444, i->pvi.width>>1, i->pvi.width, i->pvi.width, i->pvi.height);
-		conv444toRGB24(y, i->u444, i->v444, i->picture, i->pvi.width, i->pvi.width, 
+		conv422toRGB24(y, i->u422, i->v422, i->picture, i->pvi.width, i->pvi.width>>1, 
 			i->pvi.width * 3, i->pvi.width, i->pvi.height, i->vf->getMatrix(frame), 
 			i->vf->m_decoder.pc_scale);
 	}
@@ -2198,9 +2006,7 @@ extern "C" __declspec(dllexport) unsigned char* __cdecl getRGBFrameMI(int frame,
 		unsigned char *y = i->buffer;
 		unsigned char *u = y + (i->pitch * i->pvi.height);
 		unsigned char *v = u + ((i->pitch * i->pvi.height)/2);
-		conv422to444(u, i->u444, i->pvi.width>>1, i->pvi.width, i->pvi.width, i->pvi.height);
-		conv422to444(v, i->v444, i->pvi.width>>1, i->pvi.width, i->pvi.width, i->pvi.height);
-		conv444toRGB24(y, i->u444, i->v444, i->picture, i->pvi.width, i->pvi.width, 
+		conv422toRGB24(y, u, v, i->picture, i->pvi.width, i->pvi.width>>1, 
 			i->pvi.width * 3, i->pvi.width, i->pvi.height, i->vf->getMatrix(frame), 
 			i->vf->m_decoder.pc_scale);
 	}
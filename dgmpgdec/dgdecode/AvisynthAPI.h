@@ -36,11 +36,10 @@ protected:
   int _PP_MODE;
   YV12PICT *out;
   unsigned char *bufY, *bufU, *bufV; // for 4:2:2 input support
-  unsigned char *u444, *v444;		 // for RGB24 output
 
 public:
   MPEG2Source(const char* d2v, int _upConv);
-  MPEG2Source(const char* d2v, int cpu, int idct, int iPP, int moderate_h, int moderate_v, bool showQ, bool fastMC, const char* _cpu2, int _info, int _upConv, bool _i420, int iCC, IScriptEnvironment* env);
+  MPEG2Source(const char* d2v, int cpu, int idct, int iPP, int moderate_h, int moderate_v, bool showQ, bool fastMC, const char* _cpu2, int _info, int _upConv, bool _i420, int iCC, int cache, int threads, int gops, IScriptEnvironment* env);
   ~MPEG2Source();
   int MPEG2Source::getMatrix(int n);
 
@@ -78,11 +77,7 @@ void conv420to422(const unsigned char *src, unsigned char *dst, int frame_type,
 				  int dst_pitch, int width, int height);
 void conv420to422P_iSSE(const unsigned char *src, unsigned char *dst, int src_pitch, int dst_pitch,
 						int width, int height);
-void conv422to444(const unsigned char *src, unsigned char *dst, int src_pitch, int dst_pitch, 
-			int width, int height);
-void conv422to444_iSSE(const unsigned char *src, unsigned char *dst, int src_pitch, int dst_pitch, 
-			int width, int height);
-void conv444toRGB24(const unsigned char *py, const unsigned char *pu, const unsigned char *pv, 
+void conv422toRGB24(const unsigned char *py, const unsigned char *pu, const unsigned char *pv, 
 				unsigned char *dst, int src_pitchY, int src_pitchUV, int dst_pitch, int width, 
 				int height, int matrix, int pc_scale);
 
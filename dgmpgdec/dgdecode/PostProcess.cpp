@@ -483,7 +483,6 @@ INLINE void deblock_horiz_default_filter(uint8_t *v, int stride, int QP)
 
 const static uint64_t mm64_0008 = 0x0008000800080008;
 const static uint64_t mm64_0101 = 0x0101010101010101;
-static uint64_t mm64_temp;
 const static uint64_t mm64_coefs[18] =  {
 	0x0001000200040006, /* p1 left */ 0x0000000000000001, /* v1 right */
 	0x0001000200020004, /* v1 left */ 0x0000000000010001, /* v2 right */
@@ -495,14 +494,16 @@ const static uint64_t mm64_coefs[18] =  {
 	0x0001000100000000, /* v7 left */ 0x0004000200020001, /* v8 right */
 	0x0001000000000000, /* v8 left */ 0x0006000400020001  /* p2 right */
 };
-static uint32_t mm32_p1p2;
-static uint8_t *pmm1;
 
 /* The 9-tap low pass filter used in "DC" regions */
 /* I'm not sure that I like this implementation any more...! */
 INLINE void deblock_horiz_lpf9(uint8_t *v, int stride, int QP) 
 {
 	int y, p1, p2;
+	// locals, several decoders may postprocess at once
+	uint64_t mm64_temp;
+	uint32_t mm32_p1p2;
+	uint8_t *pmm1;
 
 	#ifdef PP_SELF_CHECK
 	uint8_t selfcheck[9];
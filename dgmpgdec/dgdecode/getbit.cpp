@@ -19,10 +19,13 @@
  *
  */
 
+#include <stdlib.h>
 #include "global.h"
 
 void CMPEG2Decoder::Initialize_Buffer()
 {
+	unsigned int first;
+
 	Rdptr = Rdbfr + BUFFER_SIZE;
 	Rdmax = Rdptr;
 	buffer_invalid = (unsigned char *) 0xffffffff;
@@ -31,74 +34,33 @@ void CMPEG2Decoder::Initialize_Buffer()
 	{
 		if (Rdptr >= Rdmax)
 			Next_Packet();
-		CurrentBfr = *Rdptr++ << 24;
+		first = *Rdptr++ << 24;
 
 		if (Rdptr >= Rdmax)
 			Next_Packet();
-		CurrentBfr += *Rdptr++ << 16;
+		first += *Rdptr++ << 16;
 
 		if (Rdptr >= Rdmax)
 			Next_Packet();
-		CurrentBfr += *Rdptr++ << 8;
+		first += *Rdptr++ << 8;
 
 		if (Rdptr >= Rdmax)
 			Next_Packet();
-		CurrentBfr += *Rdptr++;
-
-		Fill_Next();
+		first += *Rdptr++;
 	}
 	else
 	{
 		Fill_Buffer();
 
-		CurrentBfr = (*Rdptr << 24) + (*(Rdptr+1) << 16) + (*(Rdptr+2) << 8) + *(Rdptr+3);
+		first = _byteswap_ulong(*(unsigned int *)Rdptr);
 		Rdptr += 4;
-
-		Fill_Next();
 	}
 
-	BitsLeft = 32;
-}
-
-unsigned int CMPEG2Decoder::Get_Bits_All(unsigned int N)
-{
-	#ifdef PROFILING
-//		start_bit_timer();
-	#endif
-
-	N -= BitsLeft;
-	Val = (CurrentBfr << (32 - BitsLeft)) >> (32 - BitsLeft);
-
-	if (N != 0)
-		Val = (Val << N) + (NextBfr >> (32 - N));
-
-	CurrentBfr = NextBfr;
-	BitsLeft = 32 - N;
+	Bfr = first;
 	Fill_Next();
-
-	#ifdef PROFILING
-//		stop_bit_timer();
-	#endif
-
-	return Val;
-}
-
-void CMPEG2Decoder::Flush_Buffer_All(unsigned int N)
-{
-	#ifdef PROFILING
-//		start_bit_timer();
-	#endif
-
-	CurrentBfr = NextBfr;
-	BitsLeft = BitsLeft + 32 - N;
-	Fill_Next();
-
-	#ifdef PROFILING
-//		stop_bit_timer();
-	#endif
+	BitsLeft = 32;
 }
 
-
 typedef struct {			
 	// 1 byte
 	unsigned char sync_byte; // 		8	bslbf
@@ -151,9 +113,26 @@ void CMPEG2Decoder::Next_Transport_Packet()
 	int Packet_Header_Length;
 	unsigned int code;
 	transport_packet tp = {0};
+	int sync = (TransportPacketSize == 192) ? 4 : 0;	// offset of the sync byte
+	unsigned char *p;
 
 	for (;;)
 	{
+		// Fast path: packets that are whole in the buffer, in sync with the
+		// next one and don't carry video are stepped over without parsing
+		// them. In multi-program captures that is most of them. Anything
+		// else, and the video packets, go through the parser below.
+		for (p = Rdptr; p >= Rdbfr && p + TransportPacketSize + sync < Rdbfr + Read; p += TransportPacketSize)
+		{
+			if (p[sync] != 0x47 || p[sync + TransportPacketSize] != 0x47)
+				break;
+			code = (p[sync+1] << 16) | (p[sync+2] << 8) | p[sync+3];
+			if (((code >> 8) & 0x1fff) == (unsigned int)MPEG2_Transport_VideoPID &&
+				!(code & 0x800000) && (code & 0x30))
+				break;
+		}
+		Rdptr = p;
+
 		// 0) initialize some temp variables
 		Packet_Length = TransportPacketSize; // total length of an MPEG-2 transport packet
 
@@ -381,7 +360,6 @@ void CMPEG2Decoder::Next_PVA_Packet()
 void CMPEG2Decoder::Next_Packet()
 {
 	unsigned int code, Packet_Length, Packet_Header_Length;
-	static int stream_type;
 
 	if ( SystemStream_Flag == 2 )  // MPEG-2 transport packet?
 	{
@@ -491,10 +469,21 @@ void CMPEG2Decoder::Fill_Buffer()
 //		start_bit_timer();
 	#endif
 
-	Read = _read(Infile[File_Flag], Rdbfr, BUFFER_SIZE);
+	if (MemPtr != NULL)
+	{
+		// Past the end there are zeros, which end the slice being decoded.
+		Read = min(BUFFER_SIZE, MemEnd - MemPtr);
+		memcpy(Rdbfr, MemPtr, Read);
+		memset(Rdbfr + Read, 0, BUFFER_SIZE - Read);
+		MemPtr += Read;
+	}
+	else
+	{
+		Read = Reader.Read(Rdbfr, BUFFER_SIZE);
 
-	if (Read < BUFFER_SIZE)
-		Next_File();
+		if (Read < BUFFER_SIZE)
+			Next_File();
+	}
 
 	Rdptr = Rdbfr;
 
@@ -525,8 +514,8 @@ void CMPEG2Decoder::Next_File()
 	// Even if we ran out of files, we reread the first one, just so
 	// the decoder at least processes valid data until it detects the
 	// fault flag and exits.
-	_lseeki64(Infile[File_Flag], 0, SEEK_SET);
-	bytes = read(Infile[File_Flag], Rdbfr + Read, BUFFER_SIZE - Read);
+	Reader.Seek(Infile[File_Flag], 0);
+	bytes = Reader.Read(Rdbfr + Read, BUFFER_SIZE - Read);
 	if (Read + bytes == BUFFER_SIZE)
 		// The whole buffer has valid data.
 		buffer_invalid = (unsigned char *) 0xffffffff;
@@ -535,34 +524,25 @@ void CMPEG2Decoder::Next_File()
 		buffer_invalid = Rdbfr + Read + bytes;
 }
 
+// Bfr holds the 32 bit word being read and the one after it, BitsLeft
+// (1 to 32) are left of the first. There are always at least 33 bits in
+// Bfr, so up to 32 can be shown without looking at BitsLeft.
 unsigned int CMPEG2Decoder::Show_Bits(unsigned int N)
 {
-	if (N <= BitsLeft) {
-		return (CurrentBfr << (32 - BitsLeft)) >> (32 - N);;
-	}
-	else
-	{
-		N -= BitsLeft;
-		return (((CurrentBfr << (32 - BitsLeft)) >> (32 - BitsLeft)) << N) + (NextBfr >> (32 - N));;
-	}
+	return (unsigned int)((Bfr << (32 - BitsLeft)) >> (64 - N));
 }
 
 unsigned int CMPEG2Decoder::Get_Bits(unsigned int N)
 {
-	if (N < BitsLeft)
-	{
 	#ifdef PROFILING
 	//	start_bit_timer();
 	#endif
-		Val = (CurrentBfr << (32 - BitsLeft)) >> (32 - N);
-		BitsLeft -= N;
+	Val = Show_Bits(N);
+	Flush_Buffer(N);
 	#ifdef PROFILING
 	//	stop_bit_timer();
 	#endif
-		return Val;
-	}
-	else
-		return Get_Bits_All(N);
+	return Val;
 }
 
 void CMPEG2Decoder::Flush_Buffer(unsigned int N)
@@ -574,15 +554,22 @@ void CMPEG2Decoder::Flush_Buffer(unsigned int N)
 	if (N < BitsLeft)
 		BitsLeft -= N;
 	else
-		Flush_Buffer_All(N);
+	{
+		// the first word is used up, what is left is in the second
+		BitsLeft = BitsLeft + 32 - N;
+		Fill_Next();
+	}
 
 	#ifdef PROFILING
 //		stop_bit_timer();
 	#endif
 }
 
+// Shifts the next 32 bits of the stream into Bfr.
 void CMPEG2Decoder::Fill_Next()
 {
+	unsigned int next;
+
 	#ifdef PROFILING
 //		start_bit_timer();
 	#endif
@@ -600,43 +587,44 @@ void CMPEG2Decoder::Fill_Next()
 	{
 		if (Rdptr >= Rdmax)
 			Next_Packet();
-		NextBfr = Get_Byte() << 24;
+		next = Get_Byte() << 24;
 
 		if (Rdptr >= Rdmax)
 			Next_Packet();
-		NextBfr += Get_Byte() << 16;
+		next += Get_Byte() << 16;
 
 		if (Rdptr >= Rdmax)
 			Next_Packet();
-		NextBfr += Get_Byte() << 8;
+		next += Get_Byte() << 8;
 
 		if (Rdptr >= Rdmax)
 			Next_Packet();
-		NextBfr += Get_Byte();
+		next += Get_Byte();
 	}
 	else if (Rdptr <= Rdbfr + BUFFER_SIZE - 4)
 	{
-		NextBfr = (*Rdptr << 24) + (*(Rdptr+1) << 16) + (*(Rdptr+2) << 8) + *(Rdptr+3);
+		next = _byteswap_ulong(*(unsigned int *)Rdptr);
 		Rdptr += 4;
 	}
 	else
 	{
 		if (Rdptr >= Rdbfr+BUFFER_SIZE)
 			Fill_Buffer();
-		NextBfr = *Rdptr++ << 24;
+		next = *Rdptr++ << 24;
 
 		if (Rdptr >= Rdbfr+BUFFER_SIZE)
 			Fill_Buffer();
-		NextBfr += *Rdptr++ << 16;
+		next += *Rdptr++ << 16;
 
 		if (Rdptr >= Rdbfr+BUFFER_SIZE)
 			Fill_Buffer();
-		NextBfr += *Rdptr++ << 8;
+		next += *Rdptr++ << 8;
 
 		if (Rdptr >= Rdbfr+BUFFER_SIZE)
 			Fill_Buffer();
-		NextBfr += *Rdptr++;
+		next += *Rdptr++;
 	}
+	Bfr = (Bfr << 32) | next;
 
 	#ifdef PROFILING
 //		stop_bit_timer();
@@ -660,7 +648,7 @@ unsigned int CMPEG2Decoder::Get_Byte()
 
 	while (Rdptr >= (Rdbfr + BUFFER_SIZE))
 	{
-		Read = _read(Infile[File_Flag], Rdbfr, BUFFER_SIZE);
+		Read = Reader.Read(Rdbfr, BUFFER_SIZE);
 
 		if (Read < BUFFER_SIZE)
 			Next_File();
@@ -26,6 +26,7 @@
  */
 //#define MPEG2DEC_EXPORTS
 
+#include <xmmintrin.h>
 #include "global.h"
 #include "mc.h"
 
@@ -125,6 +126,13 @@ void CMPEG2Decoder::picture_data()
 	if (picture_structure != FRAME_PICTURE)
 		MBAmax >>= 1;
 
+	if (SliceWorkers)
+	{
+		Gather_Slices();
+		Decode_Slices(MBAmax);
+		return;
+	}
+
 	for (;;)
 	{
 		if (Fault_Flag == OUT_OF_BITS)
@@ -138,6 +146,207 @@ void CMPEG2Decoder::picture_data()
 	}
 }
 
+void CMPEG2Decoder::Start_Slice_Workers()
+{
+	int i, j;
+	DWORD id;
+	CMPEG2Decoder *w;
+
+	SliceWorkers = 0;
+	SliceQuit = false;
+	if (threads < 2)
+		return;
+
+	SliceDataMax = 1 << 20;
+	SliceData = (unsigned char *)malloc(SliceDataMax);
+	SliceMax = 256;
+	SliceStart = (int *)malloc(SliceMax * sizeof(int));
+	if (SliceData == NULL || SliceStart == NULL)
+		return;
+
+	for (i=0; i<threads && i<MAX_SLICE_THREADS; i++)
+	{
+		w = new CMPEG2Decoder;
+		w->SliceOwner = this;
+		w->SliceIndex = i;
+		for (j=0; j<8; j++)
+		{
+			w->p_block[j] = (short *)aligned_malloc(sizeof(short)*64 + 64, 32);
+			w->block[j]   = (short *)((long)w->p_block[j] + 64 - (long)w->p_block[j]%64);
+		}
+		SliceWorker[i] = w;
+		SliceStartEvent[i] = CreateEvent(NULL, FALSE, FALSE, NULL);
+		SliceDoneEvent[i] = CreateEvent(NULL, FALSE, FALSE, NULL);
+		SliceThread[i] = CreateThread(NULL, 0, Slice_Worker, w, 0, &id);
+		SliceWorkers++;
+	}
+}
+
+void CMPEG2Decoder::Stop_Slice_Workers()
+{
+	int i, j;
+
+	SliceQuit = true;
+	for (i=0; i<SliceWorkers; i++)
+		SetEvent(SliceStartEvent[i]);
+	for (i=0; i<SliceWorkers; i++)
+	{
+		WaitForSingleObject(SliceThread[i], INFINITE);
+		CloseHandle(SliceThread[i]);
+		CloseHandle(SliceStartEvent[i]);
+		CloseHandle(SliceDoneEvent[i]);
+		for (j=0; j<8; j++)
+			aligned_free(SliceWorker[i]->p_block[j]);
+		delete SliceWorker[i];
+	}
+	SliceWorkers = 0;
+
+	if (SliceData != NULL) free(SliceData);
+	if (SliceStart != NULL) free(SliceStart);
+	SliceData = NULL;
+	SliceStart = NULL;
+}
+
+/* copy the slices of the picture, start codes included, to SliceData */
+void CMPEG2Decoder::Gather_Slices()
+{
+	unsigned int code;
+
+	SliceDataSize = 0;
+	SliceCount = 0;
+
+	for (;;)
+	{
+		if (Fault_Flag == OUT_OF_BITS)
+			break;
+		next_start_code();
+		code = Show_Bits(32);
+		if (code < SLICE_START_CODE_MIN || code > SLICE_START_CODE_MAX)
+			break;
+
+		if (SliceCount == SliceMax)
+		{
+			SliceMax *= 2;
+			SliceStart = (int *)realloc(SliceStart, SliceMax * sizeof(int));
+		}
+		SliceStart[SliceCount++] = SliceDataSize;
+
+		// up to the next start code, which ends the slice
+		do
+		{
+			if (SliceDataSize == SliceDataMax)
+			{
+				SliceDataMax *= 2;
+				SliceData = (unsigned char *)realloc(SliceData, SliceDataMax);
+			}
+			SliceData[SliceDataSize++] = Get_Bits(8);
+		}
+		while (Show_Bits(24) != 0x000001 && Fault_Flag != OUT_OF_BITS);
+	}
+}
+
+void CMPEG2Decoder::Decode_Slices(int MBAmax)
+{
+	int i;
+
+	SliceMBAmax = MBAmax;
+	SliceNext = 0;
+	for (i=0; i<SliceWorkers; i++)
+	{
+		SliceWorker[i]->Take_Picture(this);
+		SetEvent(SliceStartEvent[i]);
+	}
+	WaitForMultipleObjects(SliceWorkers, SliceDoneEvent, TRUE, INFINITE);
+}
+
+/* the picture level state the slices are decoded with */
+void CMPEG2Decoder::Take_Picture(CMPEG2Decoder *dec)
+{
+	int cc;
+
+	mpeg_type = dec->mpeg_type;
+	chroma_format = dec->chroma_format;
+	block_count = dec->block_count;
+	horizontal_size = dec->horizontal_size;
+	vertical_size = dec->vertical_size;
+	mb_width = dec->mb_width;
+	mb_height = dec->mb_height;
+	Coded_Picture_Width = dec->Coded_Picture_Width;
+	Coded_Picture_Height = dec->Coded_Picture_Height;
+	Chroma_Width = dec->Chroma_Width;
+	Chroma_Height = dec->Chroma_Height;
+
+	picture_coding_type = dec->picture_coding_type;
+	picture_structure = dec->picture_structure;
+	Second_Field = dec->Second_Field;
+	top_field_first = dec->top_field_first;
+	progressive_frame = dec->progressive_frame;
+	frame_pred_frame_dct = dec->frame_pred_frame_dct;
+	concealment_motion_vectors = dec->concealment_motion_vectors;
+	intra_dc_precision = dec->intra_dc_precision;
+	intra_vlc_format = dec->intra_vlc_format;
+	q_scale_type = dec->q_scale_type;
+	alternate_scan = dec->alternate_scan;
+	full_pel_forward_vector = dec->full_pel_forward_vector;
+	forward_f_code = dec->forward_f_code;
+	full_pel_backward_vector = dec->full_pel_backward_vector;
+	backward_f_code = dec->backward_f_code;
+	memcpy(f_code, dec->f_code, sizeof(f_code));
+
+	memcpy(intra_quantizer_matrix, dec->intra_quantizer_matrix, sizeof(intra_quantizer_matrix));
+	memcpy(non_intra_quantizer_matrix, dec->non_intra_quantizer_matrix, sizeof(non_intra_quantizer_matrix));
+	memcpy(chroma_intra_quantizer_matrix, dec->chroma_intra_quantizer_matrix, sizeof(chroma_intra_quantizer_matrix));
+	memcpy(chroma_non_intra_quantizer_matrix, dec->chroma_non_intra_quantizer_matrix, sizeof(chroma_non_intra_quantizer_matrix));
+
+	for (cc=0; cc<3; cc++)
+	{
+		current_frame[cc] = dec->current_frame[cc];
+		forward_reference_frame[cc] = dec->forward_reference_frame[cc];
+		backward_reference_frame[cc] = dec->backward_reference_frame[cc];
+	}
+	QP = dec->QP;
+	backwardQP = dec->backwardQP;
+	auxQP = dec->auxQP;
+
+	IDCT_Flag = dec->IDCT_Flag;
+	idctFunc = dec->idctFunc;
+}
+
+DWORD WINAPI CMPEG2Decoder::Slice_Worker(LPVOID arg)
+{
+	CMPEG2Decoder *w = (CMPEG2Decoder *)arg;
+	CMPEG2Decoder *dec = w->SliceOwner;
+	LONG i;
+	unsigned int code;
+
+	for (;;)
+	{
+		WaitForSingleObject(dec->SliceStartEvent[w->SliceIndex], INFINITE);
+		if (dec->SliceQuit)
+			break;
+
+		while ((i = InterlockedIncrement(&dec->SliceNext) - 1) < dec->SliceCount)
+		{
+			__try
+			{
+				w->MemPtr = dec->SliceData + dec->SliceStart[i];
+				w->MemEnd = dec->SliceData + dec->SliceDataSize;
+				w->Fault_Flag = 0;
+				w->Initialize_Buffer();
+				code = w->Get_Bits(32);
+				w->slice(dec->SliceMBAmax, code);
+			}
+			__except(EXCEPTION_EXECUTE_HANDLER)
+			{
+				// a damaged slice, go on with the next one
+			}
+		}
+		__asm emms;
+		SetEvent(dec->SliceDoneEvent[w->SliceIndex]);
+	}
+	return 0;
+}
+
 /* decode all macroblocks of the current picture */
 /* ISO/IEC 13818-2 section 6.3.16 */
 void CMPEG2Decoder::slice(int MBAmax, unsigned int code)
@@ -792,10 +1001,6 @@ void CMPEG2Decoder::motion_compensation(int MBA, int macroblock_type, int motion
 {
 	int bx, by;
 	int comp;
-	short* prefetchpointer2;
-
-	if(IDCT_Flag == IDCT_SSE2MMX)
-		IDCT_CONST_PREFETCH();
 
 	/* derive current macroblock position within picture */
 	/* ISO/IEC 13818-2 section 6.3.1.6 and 6.3.1.7 */
@@ -825,15 +1030,10 @@ void CMPEG2Decoder::motion_compensation(int MBA, int macroblock_type, int motion
 
 			for (comp=0; comp<block_count-1; comp++)
 			{
-				prefetchpointer2=block[comp+1];
-				__asm {
-					mov eax,prefetchpointer2
-					prefetcht0 [eax]
-				};
-
-				SSE2MMX_IDCT(block[comp]);
+				_mm_prefetch((const char *)block[comp+1], _MM_HINT_T0);
+				SSE2_IDCT(block[comp]);
 			};
-			SSE2MMX_IDCT(block[comp]);
+			SSE2_IDCT(block[comp]);
 		#ifdef SSE2CHECK
 			sse2checkpass(4);
 		#endif
@@ -1260,6 +1460,7 @@ void CMPEG2Decoder::Decode_MPEG1_Non_Intra_Block(int comp)
 void CMPEG2Decoder::Decode_MPEG2_Intra_Block(int comp, int dc_dct_pred[])
 {	
 	long code, val = 0, i, j, sign, sum;
+	unsigned long bits;
 	const DCTtab *tab;
 	short *bp;
 	int *qmat;
@@ -1290,7 +1491,9 @@ void CMPEG2Decoder::Decode_MPEG2_Intra_Block(int comp, int dc_dct_pred[])
 	/* decode AC coefficients */
 	for (i=1; ; i++)
 	{
-		code = Show_Bits(16);
+		// the codeword and its sign bit or escape fields, all within 32 bits
+		bits = Show_Bits(32);
+		code = bits >> 16;
 
 		if (code >= 16384)
 		{
@@ -1329,14 +1532,14 @@ void CMPEG2Decoder::Decode_MPEG2_Intra_Block(int comp, int dc_dct_pred[])
 			break;
 		}
 
-		Flush_Buffer(tab->len);
 		val = tab->run;
 
 		if (val == 65)
 		{
-			// escape
-			i+= Get_Bits(6);
-			val = Get_Bits(12);
+			// escape: 6 bits of run, 12 of level
+			i+= (bits >> (26 - tab->len)) & 63;
+			val = (bits >> (14 - tab->len)) & 4095;
+			Flush_Buffer(tab->len + 18);
             if (!(val & 2047))
 			{
                 Fault_Flag = 1;
@@ -1349,10 +1552,14 @@ void CMPEG2Decoder::Decode_MPEG2_Intra_Block(int comp, int dc_dct_pred[])
 		else
 		{
 			if (val == 64)
+			{
+				Flush_Buffer(tab->len);
 				break;
+			}
 			i+= val;
 			val = tab->level;
-			sign = Get_Bits(1);
+			sign = (bits >> (31 - tab->len)) & 1;
+			Flush_Buffer(tab->len + 1);
 		}
 		if (i >= 64)
 		{
@@ -1377,6 +1584,7 @@ void CMPEG2Decoder::Decode_MPEG2_Intra_Block(int comp, int dc_dct_pred[])
 void CMPEG2Decoder::Decode_MPEG2_Non_Intra_Block(int comp)
 {
 	long code, val = 0, i, j, sign, sum;
+	unsigned long bits;
 	const DCTtab *tab;
 	short *bp;
 	int *qmat;
@@ -1389,7 +1597,9 @@ void CMPEG2Decoder::Decode_MPEG2_Non_Intra_Block(int comp)
 	sum = 0;
 	for (i=0; ; i++)
 	{
-		code = Show_Bits(16);
+		// the codeword and its sign bit or escape fields, all within 32 bits
+		bits = Show_Bits(32);
+		code = bits >> 16;
 
 		if (code >= 16384)
 		{
@@ -1418,14 +1628,14 @@ void CMPEG2Decoder::Decode_MPEG2_Non_Intra_Block(int comp)
 			break;
 		}
 
-		Flush_Buffer(tab->len);
-        val = tab->run;
+		val = tab->run;
 
 		if (val == 65)
 		{
-			// escape
-			i+= Get_Bits(6);
-			val = Get_Bits(12);
+			// escape: 6 bits of run, 12 of level
+			i+= (bits >> (26 - tab->len)) & 63;
+			val = (bits >> (14 - tab->len)) & 4095;
+			Flush_Buffer(tab->len + 18);
             if (!(val & 2047))
 			{
                 Fault_Flag = 1;
@@ -1437,11 +1647,15 @@ void CMPEG2Decoder::Decode_MPEG2_Non_Intra_Block(int comp)
 		}
 		else
 		{
-            if (val == 64)
+			if (val == 64)
+			{
+				Flush_Buffer(tab->len);
 				break;
+			}
 			i+= val;
 			val = tab->level;
-			sign = Get_Bits(1);
+			sign = (bits >> (31 - tab->len)) & 1;
+			Flush_Buffer(tab->len + 1);
 		}
 		if (i >= 64)
 		{
@@ -51,6 +51,7 @@
 #include <io.h>
 #include <fcntl.h>
 #include "misc.h"
+#include "readahead.h"
 #include "avisynth2.h"
 
 #ifdef GLOBAL
@@ -126,6 +127,8 @@ int dprintf(char* fmt, ...);
 
 #define BUFFER_SIZE			2048
 #define MAX_FILE_NUMBER		256
+#define MAX_SLICE_THREADS	16
+#define MAX_GOP_THREADS		8
 
 #define IDCT_MMX		1
 #define IDCT_SSEMMX		2
@@ -139,6 +142,32 @@ int dprintf(char* fmt, ...);
 #define FO_FILM			1
 #define FO_RAW			2
 
+// The binary index DGIndex can write next to a D2V file as *.d2v.bin, the
+// frame lines in fixed records. The header is followed by one record per
+// GOP line and one byte of flags per frame. It is only used while the size
+// and write time of the D2V are the ones it was made from.
+#define D2V_INDEX_MAGIC "DGIndexBinary16"
+
+typedef struct {
+	char				magic[16];
+	unsigned __int64	d2v_size;
+	FILETIME			d2v_time;
+	unsigned int		gops;
+	unsigned int		frames;
+} D2VINDEXHEADER;
+
+typedef struct {
+	__int64				position;
+	unsigned int		info;			// the first field of the line
+	int					matrix;
+	int					file;
+	unsigned int		I_count;
+	int					vob_id;
+	int					cell_id;
+	unsigned int		first_frame;
+	unsigned int		frames;
+} D2VINDEXGOP;
+
 // Fault_Flag values
 #define OUT_OF_BITS 11
 
@@ -187,8 +216,6 @@ protected:
   void Next_Transport_Packet(void);
   void Next_PVA_Packet(void);
   void Next_Packet(void);
-  void Flush_Buffer_All(unsigned int N);
-  unsigned int Get_Bits_All(unsigned int N);
   void Next_File(void);
 
   _INLINE_ unsigned int Show_Bits(unsigned int N);
@@ -200,8 +227,11 @@ protected:
   _INLINE_ void next_start_code(void);
 
   unsigned char Rdbfr[BUFFER_SIZE], *Rdptr, *Rdmax;
-  unsigned int CurrentBfr, NextBfr, BitsLeft, Val, Read;
+  unsigned __int64 Bfr;
+  unsigned int BitsLeft, Val, Read;
   unsigned char *buffer_invalid;
+  ReadAhead Reader;		// all seeks and reads of Infile[] go through this
+  unsigned char *MemPtr, *MemEnd;	// a slice worker reads from memory instead
 
   // gethdr.cpp
   int Get_Hdr(void);
@@ -252,6 +282,32 @@ private:
   _INLINE_ int Get_Luma_DC_dct_diff(void);
   _INLINE_ int Get_Chroma_DC_dct_diff(void);
 
+  // Slice-parallel decoding. picture_data() copies the coded slices of the
+  // picture to SliceData and the workers, decoders of their own, take them
+  // one at a time. Slices write to disjoint macroblocks of current_frame.
+  void Start_Slice_Workers(void);
+  void Stop_Slice_Workers(void);
+  void Gather_Slices(void);
+  void Decode_Slices(int MBAmax);
+  void Take_Picture(CMPEG2Decoder *dec);
+  static DWORD WINAPI Slice_Worker(LPVOID arg);
+
+  CMPEG2Decoder *SliceWorker[MAX_SLICE_THREADS];
+  HANDLE SliceThread[MAX_SLICE_THREADS];
+  HANDLE SliceStartEvent[MAX_SLICE_THREADS];
+  HANDLE SliceDoneEvent[MAX_SLICE_THREADS];
+  int SliceWorkers;
+  volatile bool SliceQuit;
+  CMPEG2Decoder *SliceOwner;	// of a worker
+  int SliceIndex;
+
+  unsigned char *SliceData;
+  int SliceDataSize, SliceDataMax;
+  int *SliceStart;			// offsets in SliceData of the slice start codes
+  int SliceCount, SliceMax;
+  int SliceMBAmax;
+  volatile LONG SliceNext;	// the next slice for a worker to take
+
   // inline?
   void form_predictions(int bx, int by, int macroblock_type, int motion_type, 
 	  int PMV[2][2][2], int motion_vertical_field_select[2][2], int dmvector[2]);
@@ -297,6 +353,7 @@ protected:
   void (__fastcall *idctFunc)(short *block);
 
   int TransportPacketSize;
+  int stream_type;	// of the last pack header, program streams only
   int MPEG2_Transport_AudioPID;  // used only for transport streams
   int MPEG2_Transport_VideoPID;  // used only for transport streams
   int MPEG2_Transport_PCRPID;  // used only for transport streams
@@ -402,7 +459,66 @@ protected:
 
   char *DirectAccess;
 
+  // GOP of every coded frame, built once by Open() so that seeks and the
+  // per-frame info lookups don't scan GOPList
+  unsigned int *GOPIndex;
+  DWORD GOPIndexSize;
+
+  // Frames delivered by Decode(), least recently used replaced first. The
+  // pictures are allocated as the slots are first used.
+  struct CACHEDFRAME {
+	YV12PICT		*pict;
+	DWORD			frame;
+	DWORD			used;
+  };
+  CACHEDFRAME *FrameCache;
+  int FrameCacheSize;
+  DWORD FrameCacheClock;
+
+  bool CacheLookup(DWORD frame, YV12PICT *dst);
+  void CacheStore(DWORD frame, YV12PICT *src);
+  YV12PICT *New_Output_Frame(void);
+
+  // GOP-parallel decoding of linear passes. Workers, decoders opened on the
+  // same project, each take the frames of the next GOP and decode them into
+  // the window of frames that starts with the one asked for last. A slot is
+  // reused for the frame GOPWindow later once the window has moved past it.
+  struct GOPSLOT {
+	YV12PICT		*pict;
+	DWORD			frame;
+	bool			ready;
+	bool			writing;
+  };
+  bool GOP_Decode(DWORD frame, YV12PICT *dst);
+  bool Start_GOP_Workers(void);
+  void Stop_GOP_Workers(void);
+  void Wake_GOP_Workers(void);
+  static DWORD WINAPI GOP_Worker(LPVOID arg);
+
+  char *D2V_Path;
+  CMPEG2Decoder *GOPWorker[MAX_GOP_THREADS];
+  HANDLE GOPThread[MAX_GOP_THREADS];
+  HANDLE GOPWake[MAX_GOP_THREADS];	// the window moved or a slot was written
+  HANDLE GOPReady;					// a frame was delivered to a slot
+  int GOPWorkers;
+  CRITICAL_SECTION GOPLock;
+  GOPSLOT *GOPSlot;
+  DWORD GOPWindow;
+  bool GOPActive;			// the workers are filling the window
+  DWORD GOPHead;			// first frame of the window
+  DWORD GOPNext;			// first frame not given to a worker yet
+  DWORD GOPLast;			// frame asked for last
+  DWORD GOPGeneration;		// changes when a seek moves the window
+  volatile bool GOPQuit;
+  CMPEG2Decoder *GOPOwner;	// of a worker
+  YV12PICT *GOPScratch;		// a worker's, for frames the window has passed
+
 public:
+  unsigned int GetGOP(DWORD coded_frame)
+  {
+	return coded_frame < GOPIndexSize ? GOPIndex[coded_frame] : VF_GOPLimit - 1;
+  }
+
   int Field_Order;
   bool HaveRFFs;
 protected:
@@ -437,6 +553,9 @@ public:
   int upConv;
   bool i420;
   int pc_scale;
+  int cache_mb;		// memory for the frame cache, set before Open(), 0 disables it
+  int threads;		// slice decoding threads, set before Open(), 0 or 1 decodes serially
+  int gops;			// GOPs decoded at once in linear passes, 0 or 1 disables it
 
   // info option stuff
   int info;
@@ -485,6 +604,7 @@ extern "C" void __fastcall MMX_IDCT(short *block);
 extern "C" void __fastcall SSEMMX_IDCT(short *block);
 extern "C" void __fastcall SSE2MMX_IDCT(short *block);
 extern "C" void __fastcall IDCT_CONST_PREFETCH(void);
+void __fastcall SSE2_IDCT(short *block);
 
 // - Nic more idct
 extern "C" void __fastcall simple_idct_mmx(short *block);
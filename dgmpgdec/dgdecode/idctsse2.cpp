@@ -0,0 +1,165 @@
+/* idctsse2.cpp, inverse DCT with SSE2 intrinsics                           */
+
+/*
+ *  The AP-922 iDCT of idctmmx.asm (SSE2MMX_IDCT) written with intrinsics,
+ *  so the compiler schedules it and it builds where inline and MASM code
+ *  don't. It does the same integer operations in the same order, the
+ *  results are identical to SSE2MMX_IDCT, streams indexed with
+ *  iDCT_Algorithm=3 decode exactly as before. tests/idcttest checks that,
+ *  and runs the IEEE 1180 accuracy test against REF_IDCT.
+ *
+ *  This file is part of DGDecode, a free MPEG-2 decoder
+ *
+ *  DGDecode is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  DGDecode is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with GNU Make; see the file COPYING.  If not, write to
+ *  the Free Software Foundation, 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+#include <emmintrin.h>
+
+#define SHIFT_INV_ROW	11
+#define SHIFT_INV_COL	6
+
+// Row constants, pre-multiplied by cos_4_16 for rows 0,4, cos_1_16 for
+// rows 1,7, cos_2_16 for rows 2,6 and cos_3_16 for rows 3,5. Each group
+// of eight is multiplied with one pair of inputs: x0 x2, x4 x6, x1 x3, x5 x7.
+static const __declspec(align(16)) short tab_i_04[32] = {
+	 16384,  21407,  16384,   8867,  16384,  -8867,  16384, -21407,
+	 16384,   8867, -16384, -21407, -16384,  21407,  16384,  -8867,
+	 22725,  19266,  19266,  -4520,  12873, -22725,   4520, -12873,
+	 12873,   4520, -22725, -12873,   4520,  19266,  19266, -22725
+};
+
+static const __declspec(align(16)) short tab_i_17[32] = {
+	 22725,  29692,  22725,  12299,  22725, -12299,  22725, -29692,
+	 22725,  12299, -22725, -29692, -22725,  29692,  22725, -12299,
+	 31521,  26722,  26722,  -6270,  17855, -31521,   6270, -17855,
+	 17855,   6270, -31521, -17855,   6270,  26722,  26722, -31521
+};
+
+static const __declspec(align(16)) short tab_i_26[32] = {
+	 21407,  27969,  21407,  11585,  21407, -11585,  21407, -27969,
+	 21407,  11585, -21407, -27969, -21407,  27969,  21407, -11585,
+	 29692,  25172,  25172,  -5906,  16819, -29692,   5906, -16819,
+	 16819,   5906, -29692, -16819,   5906,  25172,  25172, -29692
+};
+
+static const __declspec(align(16)) short tab_i_35[32] = {
+	 19266,  25172,  19266,  10426,  19266, -10426,  19266, -25172,
+	 19266,  10426, -19266, -25172, -19266,  25172,  19266, -10426,
+	 26722,  22654,  22654,  -5315,  15137, -26722,   5315, -15137,
+	 15137,   5315, -26722, -15137,   5315,  22654,  22654, -26722
+};
+
+static const short *const row_tab[8] = {
+	tab_i_04, tab_i_17, tab_i_26, tab_i_35,
+	tab_i_04, tab_i_35, tab_i_26, tab_i_17
+};
+
+// The rounding of the column pass is folded into row 0: 65536 >> 11 adds
+// 32 to every output before the final shift.
+static const int row_rounder[8] = {
+	65536, 3597, 2260, 1203, 0, 120, 512, 512
+};
+
+#define tg_1_16		13036
+#define tg_2_16		27146
+#define tg_3_16		-21746
+#define ocos_4_16	23170
+
+static __forceinline void idct_row(short *blk, const short *tab, int rounder)
+{
+	__m128i x, a, b, t;
+
+	// x0 x2 x1 x3 x4 x6 x5 x7
+	x = _mm_load_si128((const __m128i *)blk);
+	x = _mm_shufflehi_epi16(x, _MM_SHUFFLE(3,1,2,0));
+	x = _mm_shufflelo_epi16(x, _MM_SHUFFLE(3,1,2,0));
+
+	a = _mm_madd_epi16(_mm_shuffle_epi32(x, 0x00), _mm_load_si128((const __m128i *)tab));
+	t = _mm_madd_epi16(_mm_shuffle_epi32(x, 0xaa), _mm_load_si128((const __m128i *)(tab + 8)));
+	a = _mm_add_epi32(_mm_add_epi32(t, a), _mm_set1_epi32(rounder));
+
+	b = _mm_madd_epi16(_mm_shuffle_epi32(x, 0x55), _mm_load_si128((const __m128i *)(tab + 16)));
+	t = _mm_madd_epi16(_mm_shuffle_epi32(x, 0xff), _mm_load_si128((const __m128i *)(tab + 24)));
+	b = _mm_add_epi32(b, t);
+
+	// y0 y1 y2 y3 y7 y6 y5 y4
+	t = _mm_packs_epi32(_mm_srai_epi32(_mm_add_epi32(a, b), SHIFT_INV_ROW),
+						_mm_srai_epi32(_mm_sub_epi32(a, b), SHIFT_INV_ROW));
+	_mm_store_si128((__m128i *)blk, _mm_shufflehi_epi16(t, _MM_SHUFFLE(0,1,2,3)));
+}
+
+static __forceinline void idct_col(short *blk)
+{
+	__m128i x0, x1, x2, x3, x4, x5, x6, x7;
+	__m128i a0, a1, a2, a3, b0, b1, b2, b3;
+	__m128i u, v, T1, T2, T3, C4;
+
+	x0 = _mm_load_si128((const __m128i *)(blk + 0*8));
+	x1 = _mm_load_si128((const __m128i *)(blk + 1*8));
+	x2 = _mm_load_si128((const __m128i *)(blk + 2*8));
+	x3 = _mm_load_si128((const __m128i *)(blk + 3*8));
+	x4 = _mm_load_si128((const __m128i *)(blk + 4*8));
+	x5 = _mm_load_si128((const __m128i *)(blk + 5*8));
+	x6 = _mm_load_si128((const __m128i *)(blk + 6*8));
+	x7 = _mm_load_si128((const __m128i *)(blk + 7*8));
+
+	T1 = _mm_set1_epi16(tg_1_16);
+	T2 = _mm_set1_epi16(tg_2_16);
+	T3 = _mm_set1_epi16(tg_3_16);
+	C4 = _mm_set1_epi16(ocos_4_16);
+
+	// even part
+	u = _mm_adds_epi16(x0, x4);										// u04
+	v = _mm_subs_epi16(x0, x4);										// v04
+	x4 = _mm_adds_epi16(_mm_mulhi_epi16(T2, x6), x2);				// u26
+	x6 = _mm_subs_epi16(_mm_mulhi_epi16(T2, x2), x6);				// v26
+	a0 = _mm_adds_epi16(u, x4);
+	a1 = _mm_adds_epi16(v, x6);
+	a2 = _mm_subs_epi16(v, x6);
+	a3 = _mm_subs_epi16(u, x4);
+
+	// odd part
+	u = _mm_adds_epi16(_mm_mulhi_epi16(T1, x7), x1);				// u17
+	v = _mm_subs_epi16(_mm_mulhi_epi16(T1, x1), x7);				// v17
+	// tg_3_16 doesn't fit a word, multiply by tg_3_16 - 1 and add x
+	x1 = _mm_subs_epi16(_mm_adds_epi16(_mm_mulhi_epi16(T3, x3), x3), x5);	// v35
+	x7 = _mm_adds_epi16(_mm_adds_epi16(_mm_mulhi_epi16(T3, x5), x5), x3);	// u35
+	b0 = _mm_adds_epi16(u, x7);
+	b3 = _mm_subs_epi16(v, x1);
+	u = _mm_subs_epi16(u, x7);										// u12
+	v = _mm_adds_epi16(v, x1);										// v12
+	b1 = _mm_mulhi_epi16(_mm_adds_epi16(u, v), C4);
+	b1 = _mm_adds_epi16(b1, b1);
+	b2 = _mm_mulhi_epi16(_mm_subs_epi16(u, v), C4);
+	b2 = _mm_adds_epi16(b2, b2);
+
+	_mm_store_si128((__m128i *)(blk + 0*8), _mm_srai_epi16(_mm_adds_epi16(a0, b0), SHIFT_INV_COL));
+	_mm_store_si128((__m128i *)(blk + 7*8), _mm_srai_epi16(_mm_subs_epi16(a0, b0), SHIFT_INV_COL));
+	_mm_store_si128((__m128i *)(blk + 1*8), _mm_srai_epi16(_mm_adds_epi16(a1, b1), SHIFT_INV_COL));
+	_mm_store_si128((__m128i *)(blk + 6*8), _mm_srai_epi16(_mm_subs_epi16(a1, b1), SHIFT_INV_COL));
+	_mm_store_si128((__m128i *)(blk + 2*8), _mm_srai_epi16(_mm_adds_epi16(a2, b2), SHIFT_INV_COL));
+	_mm_store_si128((__m128i *)(blk + 5*8), _mm_srai_epi16(_mm_subs_epi16(a2, b2), SHIFT_INV_COL));
+	_mm_store_si128((__m128i *)(blk + 3*8), _mm_srai_epi16(_mm_adds_epi16(a3, b3), SHIFT_INV_COL));
+	_mm_store_si128((__m128i *)(blk + 4*8), _mm_srai_epi16(_mm_subs_epi16(a3, b3), SHIFT_INV_COL));
+}
+
+// block must be 16-byte aligned
+void __fastcall SSE2_IDCT(short *block)
+{
+	for (int i = 0; i < 8; i++)
+		idct_row(block + 8*i, row_tab[i], row_rounder[i]);
+	idct_col(block);
+}
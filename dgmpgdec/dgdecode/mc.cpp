@@ -116,4 +116,35 @@ void Choose_Prediction(bool fastMC)
 			ppppf_motion[1][1][3] = MC_avg_xy16_mmxext_AC;
 		}
 	}
+
+	if (cpu.sse2mmx)
+	{
+		ppppf_motion[0][0][0] = MC_put_8_sse2;
+		ppppf_motion[0][0][1] = MC_put_y8_sse2;
+		ppppf_motion[0][0][2] = MC_put_x8_sse2;
+
+		ppppf_motion[0][1][0] = MC_put_16_sse2;
+		ppppf_motion[0][1][1] = MC_put_y16_sse2;
+		ppppf_motion[0][1][2] = MC_put_x16_sse2;
+
+		ppppf_motion[1][0][0] = MC_avg_8_sse2;
+		ppppf_motion[1][0][1] = MC_avg_y8_sse2;
+		ppppf_motion[1][0][2] = MC_avg_x8_sse2;
+
+		ppppf_motion[1][1][0] = MC_avg_16_sse2;
+		ppppf_motion[1][1][1] = MC_avg_y16_sse2;
+		ppppf_motion[1][1][2] = MC_avg_x16_sse2;
+
+		if (fastMC) {
+			ppppf_motion[0][0][3] = MC_put_xy8_sse2_FAST;
+			ppppf_motion[0][1][3] = MC_put_xy16_sse2_FAST;
+			ppppf_motion[1][0][3] = MC_avg_xy8_sse2_FAST;
+			ppppf_motion[1][1][3] = MC_avg_xy16_sse2_FAST;
+		} else {
+			ppppf_motion[0][0][3] = MC_put_xy8_sse2_AC;
+			ppppf_motion[0][1][3] = MC_put_xy16_sse2_AC;
+			ppppf_motion[1][0][3] = MC_avg_xy8_sse2_AC;
+			ppppf_motion[1][1][3] = MC_avg_xy16_sse2_AC;
+		}
+	}
 }
\ No newline at end of file
@@ -96,6 +96,30 @@ MCFunc MC_avg_xy16_mmxext_FAST;
 
 }
 
+MCFunc MC_put_8_sse2;
+MCFunc MC_put_x8_sse2;
+MCFunc MC_put_y8_sse2;
+MCFunc MC_put_xy8_sse2_AC;
+MCFunc MC_put_xy8_sse2_FAST;
+
+MCFunc MC_put_16_sse2;
+MCFunc MC_put_x16_sse2;
+MCFunc MC_put_y16_sse2;
+MCFunc MC_put_xy16_sse2_AC;
+MCFunc MC_put_xy16_sse2_FAST;
+
+MCFunc MC_avg_8_sse2;
+MCFunc MC_avg_x8_sse2;
+MCFunc MC_avg_y8_sse2;
+MCFunc MC_avg_xy8_sse2_AC;
+MCFunc MC_avg_xy8_sse2_FAST;
+
+MCFunc MC_avg_16_sse2;
+MCFunc MC_avg_x16_sse2;
+MCFunc MC_avg_y16_sse2;
+MCFunc MC_avg_xy16_sse2_AC;
+MCFunc MC_avg_xy16_sse2_FAST;
+
 // Form prediction (motion compensation) function pointer array (GetPic.c) - Vlad59 04-20-2002
 extern MCFuncPtr ppppf_motion[2][2][4];
 void Choose_Prediction(bool fastMC);
\ No newline at end of file
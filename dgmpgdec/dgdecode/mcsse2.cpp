@@ -0,0 +1,157 @@
+/*
+ *  SSE2 motion compensation for DGDecode
+ *
+ *  The MMX EXT functions of mcsse.asm with SSE2 intrinsics. The 16 pixel
+ *  wide blocks take one register per line, the 8 pixel wide ones two lines
+ *  per register. The results are the same as those of mcsse.asm, the _AC
+ *  variants are exact, the _FAST ones round the four-point average the
+ *  same way MC_put_xy8_mmxext_FAST does. tests/mctest checks all of them
+ *  against C and mcsse.asm.
+ *
+ *  This file is part of DGDecode, a free MPEG-2 decoder
+ *
+ *  DGDecode is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  DGDecode is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with GNU Make; see the file COPYING.  If not, write to
+ *  the Free Software Foundation, 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+#include <emmintrin.h>
+#include "mc.h"
+
+// Neither the references nor the destinations of field predictions are
+// aligned, so all loads and stores are unaligned.
+#define LOAD16(p)		_mm_loadu_si128((const __m128i *)(p))
+#define STORE16(p, v)	_mm_storeu_si128((__m128i *)(p), v)
+
+// two 8 pixel lines in one register
+static __forceinline __m128i load8x2(const unsigned char *p, int stride)
+{
+	return _mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i *)p),
+							  _mm_loadl_epi64((const __m128i *)(p + stride)));
+}
+
+static __forceinline void store8x2(unsigned char *p, int stride, __m128i v)
+{
+	_mm_storel_epi64((__m128i *)p, v);
+	_mm_storel_epi64((__m128i *)(p + stride), _mm_unpackhi_epi64(v, v));
+}
+
+// (a + b + c + d + 2) >> 2, a and b from one line, c and d from the other
+static __forceinline __m128i avg4_ac(__m128i a, __m128i b, __m128i c, __m128i d)
+{
+	__m128i ad = _mm_avg_epu8(a, d);
+	__m128i bc = _mm_avg_epu8(b, c);
+	// pavgb rounds up, take back the 1 it added twice too many
+	__m128i err = _mm_or_si128(_mm_xor_si128(a, d), _mm_xor_si128(b, c));
+	err = _mm_and_si128(err, _mm_xor_si128(ad, bc));
+	err = _mm_and_si128(err, _mm_set1_epi8(1));
+	return _mm_subs_epu8(_mm_avg_epu8(ad, bc), err);
+}
+
+static __forceinline __m128i avg4_fast(__m128i a, __m128i b, __m128i c, __m128i d)
+{
+	return _mm_subs_epu8(_mm_avg_epu8(_mm_avg_epu8(a, d), _mm_avg_epu8(b, c)), _mm_set1_epi8(1));
+}
+
+// The prediction of one register. MODE is 0 for full-pel, 1 for half-pel
+// horizontally, 2 vertically and 3 for both; AVG averages with dest.
+#define MC_PRED16(MODE, AC, src, off)											\
+	(MODE == 0 ? LOAD16(src) :													\
+	 MODE == 1 ? _mm_avg_epu8(LOAD16(src), LOAD16(src + 1)) :					\
+	 MODE == 2 ? _mm_avg_epu8(LOAD16(src), LOAD16(off)) :						\
+	 AC ? avg4_ac(LOAD16(src), LOAD16(src + 1), LOAD16(off), LOAD16(off + 1)) :	\
+		  avg4_fast(LOAD16(src), LOAD16(src + 1), LOAD16(off), LOAD16(off + 1)))
+
+#define MC_PRED8(MODE, AC, src, off, stride)									\
+	(MODE == 0 ? load8x2(src, stride) :											\
+	 MODE == 1 ? _mm_avg_epu8(load8x2(src, stride), load8x2(src + 1, stride)) :	\
+	 MODE == 2 ? _mm_avg_epu8(load8x2(src, stride), load8x2(off, stride)) :		\
+	 AC ? avg4_ac(load8x2(src, stride), load8x2(src + 1, stride),				\
+				  load8x2(off, stride), load8x2(off + 1, stride)) :				\
+		  avg4_fast(load8x2(src, stride), load8x2(src + 1, stride),			\
+					load8x2(off, stride), load8x2(off + 1, stride)))
+
+template <int MODE, bool AVG, bool AC>
+static __forceinline void mc16(unsigned char *dest, unsigned char *ref, int stride, int offs, int height)
+{
+	unsigned char *off = ref + offs;
+	__m128i p;
+
+	for (; height > 0; height--)
+	{
+		p = MC_PRED16(MODE, AC, ref, off);
+		if (AVG)
+			p = _mm_avg_epu8(p, LOAD16(dest));
+		STORE16(dest, p);
+		ref += stride;
+		off += stride;
+		dest += stride;
+	}
+}
+
+template <int MODE, bool AVG, bool AC>
+static __forceinline void mc8(unsigned char *dest, unsigned char *ref, int stride, int offs, int height)
+{
+	unsigned char *off = ref + offs;
+	__m128i p;
+
+	for (; height > 1; height -= 2)
+	{
+		p = MC_PRED8(MODE, AC, ref, off, stride);
+		if (AVG)
+			p = _mm_avg_epu8(p, load8x2(dest, stride));
+		store8x2(dest, stride, p);
+		ref += 2*stride;
+		off += 2*stride;
+		dest += 2*stride;
+	}
+	if (height)
+	{
+		// the second line is a repeat of the first
+		p = MC_PRED8(MODE, AC, ref, off, 0);
+		if (AVG)
+			p = _mm_avg_epu8(p, load8x2(dest, 0));
+		_mm_storel_epi64((__m128i *)dest, p);
+	}
+}
+
+#define MC_FUNC(name, size, MODE, AVG, AC)												\
+void name(unsigned char *dest, unsigned char *ref, int stride, int offs, int height)	\
+{																						\
+	mc##size<MODE, AVG, AC>(dest, ref, stride, offs, height);							\
+}
+
+MC_FUNC(MC_put_8_sse2,        8, 0, false, true)
+MC_FUNC(MC_put_x8_sse2,       8, 1, false, true)
+MC_FUNC(MC_put_y8_sse2,       8, 2, false, true)
+MC_FUNC(MC_put_xy8_sse2_AC,   8, 3, false, true)
+MC_FUNC(MC_put_xy8_sse2_FAST, 8, 3, false, false)
+
+MC_FUNC(MC_put_16_sse2,        16, 0, false, true)
+MC_FUNC(MC_put_x16_sse2,       16, 1, false, true)
+MC_FUNC(MC_put_y16_sse2,       16, 2, false, true)
+MC_FUNC(MC_put_xy16_sse2_AC,   16, 3, false, true)
+MC_FUNC(MC_put_xy16_sse2_FAST, 16, 3, false, false)
+
+MC_FUNC(MC_avg_8_sse2,        8, 0, true, true)
+MC_FUNC(MC_avg_x8_sse2,       8, 1, true, true)
+MC_FUNC(MC_avg_y8_sse2,       8, 2, true, true)
+MC_FUNC(MC_avg_xy8_sse2_AC,   8, 3, true, true)
+MC_FUNC(MC_avg_xy8_sse2_FAST, 8, 3, true, false)
+
+MC_FUNC(MC_avg_16_sse2,        16, 0, true, true)
+MC_FUNC(MC_avg_x16_sse2,       16, 1, true, true)
+MC_FUNC(MC_avg_y16_sse2,       16, 2, true, true)
+MC_FUNC(MC_avg_xy16_sse2_AC,   16, 3, true, true)
+MC_FUNC(MC_avg_xy16_sse2_FAST, 16, 3, true, false)
@@ -0,0 +1,234 @@
+/*
+ *  Read-ahead for the bitstream reader of DGDecode
+ *
+ *  This file is part of DGDecode, a free MPEG-2 decoder
+ *
+ *  DGDecode is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  DGDecode is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with GNU Make; see the file COPYING.  If not, write to
+ *  the Free Software Foundation, 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+#include <io.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "readahead.h"
+
+#define BLOCK_START(pos)	((pos) & ~(__int64)(READAHEAD_BLOCK_SIZE - 1))
+
+ReadAhead::ReadAhead()
+{
+	for (int i = 0; i < READAHEAD_BLOCKS; i++)
+	{
+		blocks[i].fd = -1;
+		blocks[i].offset = 0;
+		blocks[i].length = 0;
+		blocks[i].ready = false;
+		blocks[i].loading = false;
+		blocks[i].data = NULL;
+	}
+	fd = -1;
+	pos = 0;
+	quit = false;
+	InitializeCriticalSection(&lock);
+	wake = CreateEvent(NULL, FALSE, FALSE, NULL);
+	loaded = CreateEvent(NULL, FALSE, FALSE, NULL);
+	// the blocks and the thread come with the first Seek(), decoders that
+	// never read files don't need them
+	thread = NULL;
+}
+
+ReadAhead::~ReadAhead()
+{
+	if (thread != NULL)
+	{
+		quit = true;
+		SetEvent(wake);
+		WaitForSingleObject(thread, INFINITE);
+		CloseHandle(thread);
+	}
+	CloseHandle(wake);
+	CloseHandle(loaded);
+	DeleteCriticalSection(&lock);
+	for (int i = 0; i < READAHEAD_BLOCKS; i++)
+		free(blocks[i].data);
+}
+
+DWORD WINAPI ReadAhead::Run(LPVOID arg)
+{
+	ReadAhead *ra = (ReadAhead *)arg;
+
+	while (!ra->quit)
+	{
+		if (!ra->LoadNext())
+			WaitForSingleObject(ra->wake, INFINITE);
+	}
+	return 0;
+}
+
+// Called with the lock held.
+ReadAhead::Block *ReadAhead::Find(__int64 offset)
+{
+	for (int i = 0; i < READAHEAD_BLOCKS; i++)
+	{
+		if (blocks[i].fd == fd && blocks[i].offset == offset && (blocks[i].ready || blocks[i].loading))
+			return &blocks[i];
+	}
+	return NULL;
+}
+
+// Loads the first missing block of the window that starts with the block
+// holding the read position. Returns false if there was nothing to load.
+bool ReadAhead::LoadNext()
+{
+	__int64 first, want = -1;
+	Block *b = NULL;
+	int file, length, bytes;
+
+	EnterCriticalSection(&lock);
+	if (fd < 0)
+	{
+		LeaveCriticalSection(&lock);
+		return false;
+	}
+	first = BLOCK_START(pos);
+	for (int i = 0; i < READAHEAD_BLOCKS; i++)
+	{
+		__int64 offset = first + (__int64)i * READAHEAD_BLOCK_SIZE;
+		Block *found = Find(offset);
+		if (found == NULL)
+		{
+			want = offset;
+			break;
+		}
+		// nothing follows a short block
+		if (found->ready && found->length < READAHEAD_BLOCK_SIZE)
+			break;
+	}
+	if (want < 0)
+	{
+		LeaveCriticalSection(&lock);
+		return false;
+	}
+	// There are as many blocks as the window is long, so one of them is
+	// outside it if a block of the window is missing.
+	for (int i = 0; i < READAHEAD_BLOCKS; i++)
+	{
+		if (blocks[i].fd != fd || blocks[i].offset < first ||
+			blocks[i].offset >= first + (__int64)READAHEAD_BLOCKS * READAHEAD_BLOCK_SIZE ||
+			!(blocks[i].ready || blocks[i].loading))
+		{
+			b = &blocks[i];
+			break;
+		}
+	}
+	b->fd = file = fd;
+	b->offset = want;
+	b->ready = false;
+	b->loading = true;
+	LeaveCriticalSection(&lock);
+
+	length = 0;
+	if (_lseeki64(file, want, SEEK_SET) == want)
+	{
+		while (length < READAHEAD_BLOCK_SIZE)
+		{
+			bytes = _read(file, b->data + length, READAHEAD_BLOCK_SIZE - length);
+			if (bytes <= 0)
+				break;
+			length += bytes;
+		}
+	}
+
+	EnterCriticalSection(&lock);
+	b->length = length;
+	b->loading = false;
+	b->ready = true;
+	LeaveCriticalSection(&lock);
+	SetEvent(loaded);
+	return true;
+}
+
+void ReadAhead::Seek(int file, __int64 offset)
+{
+	DWORD id;
+
+	if (thread == NULL)
+	{
+		for (int i = 0; i < READAHEAD_BLOCKS; i++)
+			blocks[i].data = (unsigned char *)malloc(READAHEAD_BLOCK_SIZE);
+		thread = CreateThread(NULL, 0, Run, this, 0, &id);
+	}
+	EnterCriticalSection(&lock);
+	fd = file;
+	pos = offset;
+	LeaveCriticalSection(&lock);
+	SetEvent(wake);
+}
+
+int ReadAhead::Read(unsigned char *dst, int size)
+{
+	int done = 0, skip, n;
+	__int64 start;
+	Block *b;
+
+	EnterCriticalSection(&lock);
+	start = pos;
+	while (done < size && fd >= 0)
+	{
+		b = Find(BLOCK_START(pos));
+		if (b == NULL || !b->ready)
+		{
+			// The thread hasn't got this far yet.
+			LeaveCriticalSection(&lock);
+			SetEvent(wake);
+			WaitForSingleObject(loaded, INFINITE);
+			EnterCriticalSection(&lock);
+			continue;
+		}
+		skip = (int)(pos - b->offset);
+		if (skip >= b->length)
+			break;
+		n = min(size - done, b->length - skip);
+		memcpy(dst + done, b->data + skip, n);
+		done += n;
+		pos += n;
+	}
+	LeaveCriticalSection(&lock);
+
+	// Moving into another block frees one for the thread.
+	if (BLOCK_START(pos) != BLOCK_START(start))
+		SetEvent(wake);
+	return done;
+}
+
+void ReadAhead::Reset()
+{
+	EnterCriticalSection(&lock);
+	// stops the thread from starting on another block
+	fd = -1;
+	pos = 0;
+	for (int i = 0; i < READAHEAD_BLOCKS; i++)
+	{
+		while (blocks[i].loading)
+		{
+			LeaveCriticalSection(&lock);
+			WaitForSingleObject(loaded, INFINITE);
+			EnterCriticalSection(&lock);
+		}
+		blocks[i].fd = -1;
+		blocks[i].ready = false;
+	}
+	LeaveCriticalSection(&lock);
+}
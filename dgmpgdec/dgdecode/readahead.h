@@ -0,0 +1,77 @@
+/*
+ *  Read-ahead for the bitstream reader of DGDecode
+ *
+ *  This file is part of DGDecode, a free MPEG-2 decoder
+ *
+ *  DGDecode is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  DGDecode is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with GNU Make; see the file COPYING.  If not, write to
+ *  the Free Software Foundation, 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+#ifndef __READAHEAD_H
+#define __READAHEAD_H
+
+#include <windows.h>
+
+#define READAHEAD_BLOCK_SIZE	(1 << 20)
+#define READAHEAD_BLOCKS		4
+
+// Stands in for _lseeki64()/_read() on the source files. The decoder reads one
+// file at a time and always seeks when it moves to another, so there is a
+// single read position. A background thread keeps the blocks following it
+// loaded: the decoder's small refills are served from memory and a slow disk
+// or network share only stalls it when it outruns the thread. Blocks that are
+// still loaded also make short seeks back free.
+class ReadAhead
+{
+public:
+	ReadAhead();
+	~ReadAhead();
+
+	void Seek(int fd, __int64 pos);
+	// returns the number of bytes read, less than size only at the end of the file
+	int Read(unsigned char *dst, int size);
+	// drops all blocks, must be called before closing any of the files
+	void Reset();
+
+private:
+	struct Block
+	{
+		int fd;
+		__int64 offset;
+		int length;			// short at the end of the file
+		bool ready;
+		bool loading;
+		unsigned char *data;
+	};
+
+	Block blocks[READAHEAD_BLOCKS];
+	int fd;					// the read position
+	__int64 pos;
+
+	CRITICAL_SECTION lock;
+	HANDLE wake;			// the position moved or a block was freed
+	HANDLE loaded;			// a block finished loading
+	HANDLE thread;
+	volatile bool quit;
+
+	static DWORD WINAPI Run(LPVOID arg);
+	bool LoadNext();
+	Block *Find(__int64 offset);
+
+	ReadAhead(const ReadAhead&);
+	ReadAhead& operator=(const ReadAhead&);
+};
+
+#endif
@@ -0,0 +1,189 @@
+/* idcttest.cpp, IEEE 1180 accuracy test of the SSE2 iDCT                    */
+
+/*
+ *  Runs the IEEE 1180-1990 procedure on SSE2_IDCT: random blocks are put
+ *  through a double precision forward DCT, rounded and clipped to
+ *  -2048..2047, then compared after REF_IDCT and SSE2_IDCT, both clipped
+ *  to -256..255. Every block also goes through SSE2MMX_IDCT, which
+ *  SSE2_IDCT has to match bit for bit, since streams indexed with
+ *  iDCT_Algorithm=3 used it before.
+ *
+ *  Usage: idcttest [blocks per test, default 10000]
+ *  Exits with 1 if any limit of the standard is exceeded or any block
+ *  differs from SSE2MMX_IDCT.
+ *
+ *  This file is part of DGDecode, a free MPEG-2 decoder
+ *
+ *  DGDecode is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  DGDecode is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with GNU Make; see the file COPYING.  If not, write to
+ *  the Free Software Foundation, 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+extern "C" void __fastcall SSE2MMX_IDCT(short *block);
+void __fastcall SSE2_IDCT(short *block);
+void __fastcall REF_IDCT(short *block);
+
+static double c[8][8];	// c[k][n] = basis function k at sample n
+
+static void init_dct(void)
+{
+	for (int k = 0; k < 8; k++)
+		for (int n = 0; n < 8; n++)
+			c[k][n] = (k ? 0.5 : sqrt(0.125)) * cos((2*n + 1) * k * 3.14159265358979323846 / 16);
+}
+
+static int clip(int x, int lo, int hi)
+{
+	return x < lo ? lo : x > hi ? hi : x;
+}
+
+static int round_half_up(double x)
+{
+	return (int)floor(x + 0.5);
+}
+
+// the standard's forward DCT: 2D double, rounded and clipped to 12 bits
+static void fdct(const short *in, short *out)
+{
+	double tmp[64];
+	for (int i = 0; i < 8; i++)
+		for (int k = 0; k < 8; k++)
+		{
+			double s = 0;
+			for (int n = 0; n < 8; n++)
+				s += c[k][n] * in[8*i + n];
+			tmp[8*i + k] = s;
+		}
+	for (int k = 0; k < 8; k++)
+		for (int j = 0; j < 8; j++)
+		{
+			double s = 0;
+			for (int n = 0; n < 8; n++)
+				s += c[k][n] * tmp[8*n + j];
+			out[8*k + j] = (short)clip(round_half_up(s), -2048, 2047);
+		}
+}
+
+// the generator the standard specifies, so the blocks match its tables
+static unsigned int randx;
+
+static int ieee_rand(int L, int H)
+{
+	randx = randx * 1103515245u + 12345u;
+	double x = (double)(randx & 0x7ffffffe) / (double)0x7fffffff;
+	return (int)(x * (L + H + 1)) - L;
+}
+
+struct Limits {
+	int peak;
+	double pmse, omse, pme, ome;
+};
+
+static const Limits limits = { 1, 0.06, 0.02, 0.015, 0.0015 };
+
+static bool run_test(int L, int H, int sign, int blocks, int *mismatches)
+{
+	__declspec(align(16)) short block[64], ref[64], test[64], mmx[64];
+	int err_sum[64] = {0}, err_sq[64] = {0};
+	int peak = 0;
+
+	randx = 1;
+	for (int b = 0; b < blocks; b++)
+	{
+		for (int i = 0; i < 64; i++)
+			block[i] = (short)(ieee_rand(L, H) * sign);
+		fdct(block, block);
+		memcpy(ref, block, sizeof(block));
+		memcpy(test, block, sizeof(block));
+		memcpy(mmx, block, sizeof(block));
+		REF_IDCT(ref);
+		SSE2_IDCT(test);
+		SSE2MMX_IDCT(mmx);
+		if (memcmp(test, mmx, sizeof(test)))
+			(*mismatches)++;
+		for (int i = 0; i < 64; i++)
+		{
+			int e = clip(test[i], -256, 255) - clip(ref[i], -256, 255);
+			err_sum[i] += e;
+			err_sq[i] += e*e;
+			if (abs(e) > peak)
+				peak = abs(e);
+		}
+	}
+
+	double pmse = 0, pme = 0, omse = 0, ome = 0;
+	for (int i = 0; i < 64; i++)
+	{
+		double mse = (double)err_sq[i] / blocks;
+		double me = (double)err_sum[i] / blocks;
+		if (mse > pmse)
+			pmse = mse;
+		if (fabs(me) > pme)
+			pme = fabs(me);
+		omse += mse;
+		ome += me;
+	}
+	omse /= 64;
+	ome /= 64;
+
+	bool ok = peak <= limits.peak && pmse <= limits.pmse && omse <= limits.omse &&
+			  pme <= limits.pme && fabs(ome) <= limits.ome;
+	printf("L=%d H=%d sign=%+d: peak %d, pmse %.4f, omse %.5f, pme %.4f, ome %.5f  %s\n",
+		   L, H, sign, peak, pmse, omse, pme, ome, ok ? "ok" : "FAILED");
+	return ok;
+}
+
+// an all-zero block has to come out all zero
+static bool zero_test(void)
+{
+	__declspec(align(16)) short block[64];
+	memset(block, 0, sizeof(block));
+	SSE2_IDCT(block);
+	for (int i = 0; i < 64; i++)
+		if (block[i])
+		{
+			printf("zero in, zero out: FAILED\n");
+			return false;
+		}
+	printf("zero in, zero out: ok\n");
+	return true;
+}
+
+int main(int argc, char **argv)
+{
+	static const int ranges[3][2] = { {256, 255}, {5, 5}, {300, 300} };
+	int blocks = argc > 1 ? atoi(argv[1]) : 10000;
+	int mismatches = 0;
+	bool ok = true;
+
+	if (blocks < 1)
+	{
+		fprintf(stderr, "usage: idcttest [blocks per test]\n");
+		return 2;
+	}
+	init_dct();
+	for (int r = 0; r < 3; r++)
+		for (int sign = 1; sign >= -1; sign -= 2)
+			ok &= run_test(ranges[r][0], ranges[r][1], sign, blocks, &mismatches);
+	ok &= zero_test();
+
+	printf("SSE2_IDCT vs SSE2MMX_IDCT: %d of %d blocks differ  %s\n",
+		   mismatches, 6*blocks, mismatches ? "FAILED" : "ok");
+	return ok && !mismatches ? 0 : 1;
+}
@@ -0,0 +1,183 @@
+/* mctest.cpp, checks the SSE2 motion compensation against plain C          */
+
+/*
+ *  Every MC_*_sse2 function is run on random pictures, with random
+ *  alignment, strides, line offsets and heights 1 to 17, so the odd-height
+ *  tail of the 8 pixel wide functions is covered too. The destination is
+ *  compared with the C versions below, including the bytes around the
+ *  block, which must be left alone. The _AC xy variants have to give the
+ *  exact (a + b + c + d + 2) >> 2 average, the _FAST ones the rounding of
+ *  the MCxyFAST macro in mcsse.asm. Each result is also compared with the
+ *  MMX EXT function the SSE2 one replaces.
+ *
+ *  Usage: mctest [cases per function, default 20000]
+ *  Exits with 1 if any function differs.
+ *
+ *  This file is part of DGDecode, a free MPEG-2 decoder
+ *
+ *  DGDecode is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  DGDecode is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with GNU Make; see the file COPYING.  If not, write to
+ *  the Free Software Foundation, 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <mmintrin.h>
+#include "mc.h"
+
+#define MAX_STRIDE	96
+#define MAX_HEIGHT	17
+// room for the block, the line offset and the one pixel half-pel overreach
+#define BUF_SIZE	(MAX_STRIDE * (2*MAX_HEIGHT + 4))
+
+static inline int avg2(int a, int b)
+{
+	return (a + b + 1) >> 1;
+}
+
+// The C versions. MODE is 0 for full-pel, 1 for half-pel horizontally,
+// 2 vertically and 3 for both.
+static void mc_c(int size, int mode, bool avg, bool ac, unsigned char *dest,
+				 const unsigned char *ref, int stride, int offs, int height)
+{
+	for (int y = 0; y < height; y++)
+	{
+		const unsigned char *src = ref + y*stride;
+		const unsigned char *off = src + offs;
+		for (int x = 0; x < size; x++)
+		{
+			int a = src[x], b = src[x + 1], c = off[x], d = off[x + 1];
+			int p;
+			if (mode == 0)
+				p = a;
+			else if (mode == 1)
+				p = avg2(a, b);
+			else if (mode == 2)
+				p = avg2(a, c);
+			else if (ac)
+				p = (a + b + c + d + 2) >> 2;
+			else
+			{
+				p = avg2(avg2(a, d), avg2(b, c));
+				p = p ? p - 1 : 0;
+			}
+			if (avg)
+				p = avg2(p, dest[y*stride + x]);
+			dest[y*stride + x] = (unsigned char)p;
+		}
+	}
+}
+
+struct MCTest {
+	const char *name;
+	MCFunc *sse2;
+	MCFunc *mmxext;
+	int size, mode;
+	bool avg, ac;
+};
+
+static const MCTest tests[] = {
+	{ "put_8",        MC_put_8_sse2,         MC_put_8_mmxext,          8, 0, false, true  },
+	{ "put_x8",       MC_put_x8_sse2,        MC_put_x8_mmxext,         8, 1, false, true  },
+	{ "put_y8",       MC_put_y8_sse2,        MC_put_y8_mmxext,         8, 2, false, true  },
+	{ "put_xy8_AC",   MC_put_xy8_sse2_AC,    MC_put_xy8_mmxext_AC,     8, 3, false, true  },
+	{ "put_xy8_FAST", MC_put_xy8_sse2_FAST,  MC_put_xy8_mmxext_FAST,   8, 3, false, false },
+	{ "put_16",       MC_put_16_sse2,        MC_put_16_mmxext,        16, 0, false, true  },
+	{ "put_x16",      MC_put_x16_sse2,       MC_put_x16_mmxext,       16, 1, false, true  },
+	{ "put_y16",      MC_put_y16_sse2,       MC_put_y16_mmxext,       16, 2, false, true  },
+	{ "put_xy16_AC",  MC_put_xy16_sse2_AC,   MC_put_xy16_mmxext_AC,   16, 3, false, true  },
+	{ "put_xy16_FAST",MC_put_xy16_sse2_FAST, MC_put_xy16_mmxext_FAST, 16, 3, false, false },
+	{ "avg_8",        MC_avg_8_sse2,         MC_avg_8_mmxext,          8, 0, true,  true  },
+	{ "avg_x8",       MC_avg_x8_sse2,        MC_avg_x8_mmxext,         8, 1, true,  true  },
+	{ "avg_y8",       MC_avg_y8_sse2,        MC_avg_y8_mmxext,         8, 2, true,  true  },
+	{ "avg_xy8_AC",   MC_avg_xy8_sse2_AC,    MC_avg_xy8_mmxext_AC,     8, 3, true,  true  },
+	{ "avg_xy8_FAST", MC_avg_xy8_sse2_FAST,  MC_avg_xy8_mmxext_FAST,   8, 3, true,  false },
+	{ "avg_16",       MC_avg_16_sse2,        MC_avg_16_mmxext,        16, 0, true,  true  },
+	{ "avg_x16",      MC_avg_x16_sse2,       MC_avg_x16_mmxext,       16, 1, true,  true  },
+	{ "avg_y16",      MC_avg_y16_sse2,       MC_avg_y16_mmxext,       16, 2, true,  true  },
+	{ "avg_xy16_AC",  MC_avg_xy16_sse2_AC,   MC_avg_xy16_mmxext_AC,   16, 3, true,  true  },
+	{ "avg_xy16_FAST",MC_avg_xy16_sse2_FAST, MC_avg_xy16_mmxext_FAST, 16, 3, true,  false },
+};
+
+static void fill(unsigned char *buf, int len)
+{
+	// mostly noise, with runs of 0 and 255 for the saturating corner cases
+	int mode = rand() % 4;
+	for (int i = 0; i < len; i++)
+		buf[i] = (unsigned char)(mode == 0 ? 0 : mode == 1 ? 255 : rand());
+	if (mode < 2)
+		for (int i = 0; i < len; i += 1 + rand() % 7)
+			buf[i] = (unsigned char)rand();
+}
+
+static bool run_test(const MCTest &t, int cases)
+{
+	static unsigned char ref[BUF_SIZE + 32];
+	static unsigned char dest[BUF_SIZE + 32];
+	static unsigned char want[BUF_SIZE + 32];
+	static unsigned char mmx[BUF_SIZE + 32];
+	int c_diffs = 0, mmx_diffs = 0;
+
+	for (int n = 0; n < cases; n++)
+	{
+		// strides are multiples of 8 as in the decoder, the pointers aren't aligned
+		int stride = (t.size + 8 + rand() % (MAX_STRIDE - t.size - 8)) & ~7;
+		int height = 1 + rand() % MAX_HEIGHT;
+		int offs = rand() % 2 ? stride : 2*stride;
+		unsigned char *r = ref + rand() % 16;
+		unsigned char *d = dest + rand() % 16;
+
+		fill(ref, sizeof(ref));
+		fill(dest, sizeof(dest));
+		memcpy(want, dest, sizeof(dest));
+		memcpy(mmx, dest, sizeof(dest));
+
+		mc_c(t.size, t.mode, t.avg, t.ac, want + (d - dest), r, stride, offs, height);
+		t.mmxext(mmx + (d - dest), r, stride, offs, height);
+		t.sse2(d, r, stride, offs, height);
+
+		if (memcmp(dest, want, sizeof(dest)))
+		{
+			if (!c_diffs)
+				printf("%s: first difference from C at stride %d, offs %d, height %d\n",
+					   t.name, stride, offs, height);
+			c_diffs++;
+		}
+		if (memcmp(dest, mmx, sizeof(dest)))
+			mmx_diffs++;
+	}
+	// mcsse.asm leaves the MMX state set
+	_mm_empty();
+
+	printf("%-14s %d cases, %d differ from C, %d from MMX EXT  %s\n",
+		   t.name, cases, c_diffs, mmx_diffs, c_diffs || mmx_diffs ? "FAILED" : "ok");
+	return !c_diffs && !mmx_diffs;
+}
+
+int main(int argc, char **argv)
+{
+	int cases = argc > 1 ? atoi(argv[1]) : 20000;
+	bool ok = true;
+
+	if (cases < 1)
+	{
+		fprintf(stderr, "usage: mctest [cases per function]\n");
+		return 2;
+	}
+	srand(1);
+	for (int i = 0; i < (int)(sizeof(tests) / sizeof(tests[0])); i++)
+		ok &= run_test(tests[i], cases);
+	return ok ? 0 : 1;
+}
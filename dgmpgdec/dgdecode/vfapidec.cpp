@@ -41,8 +41,10 @@ CMPEG2Decoder::CMPEG2Decoder()
   prev_frame = 0xfffffffe;
   memset(Rdbfr, 0, sizeof(Rdbfr));
   Rdptr = Rdmax = 0;
-  CurrentBfr = NextBfr = BitsLeft = Val = Read = 0;
+  Bfr = 0;
+  BitsLeft = Val = Read = 0;
   Fault_Flag = File_Flag = File_Limit = FO_Flag = IDCT_Flag = SystemStream_Flag = 0;
+  stream_type = 0;
   Luminance_Flag = false;
   BufferOp = 0;
   memset(intra_quantizer_matrix, 0, sizeof(intra_quantizer_matrix));
@@ -63,15 +65,95 @@ CMPEG2Decoder::CMPEG2Decoder()
   moderate_v = 40;
   i420 = false;
   pc_scale = 1;
+  cache_mb = 32;
+  threads = 1;
+  gops = 0;
   maxquant = minquant = avgquant = 0;
   AVSenv = NULL;
   u422 = v422 = NULL;
   DirectAccess = NULL;
+  GOPIndex = NULL;
+  GOPIndexSize = 0;
+  FrameCache = NULL;
+  FrameCacheSize = 0;
+  FrameCacheClock = 0;
+  MemPtr = MemEnd = NULL;
+  SliceWorkers = 0;
+  SliceOwner = NULL;
+  SliceData = NULL;
+  SliceStart = NULL;
+  D2V_Path = NULL;
+  GOPWorkers = 0;
+  GOPSlot = NULL;
+  GOPActive = false;
+  GOPLast = 0xfffffffe;
+  GOPOwner = NULL;
+  GOPScratch = NULL;
   FrameList = NULL;
   GOPList = NULL;
   GOPListSize = 0;
 }
 
+// Maps the binary index of the D2V file, see D2VINDEXHEADER. Returns NULL
+// if there is none or it doesn't belong to the D2V as it is now.
+static const D2VINDEXHEADER *Map_D2V_Index(const char *path)
+{
+	char name[_MAX_PATH + 8];
+	WIN32_FILE_ATTRIBUTE_DATA attr;
+	HANDLE file, mapping;
+	LARGE_INTEGER size;
+	const D2VINDEXHEADER *hdr;
+	const D2VINDEXGOP *gop;
+	unsigned __int64 frames;
+	unsigned int i;
+
+	if (strlen(path) >= _MAX_PATH || !GetFileAttributesEx(path, GetFileExInfoStandard, &attr))
+		return NULL;
+	sprintf(name, "%s.bin", path);
+	file = CreateFile(name, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+		return NULL;
+	if (!GetFileSizeEx(file, &size) || size.QuadPart < sizeof(D2VINDEXHEADER) || size.HighPart)
+	{
+		CloseHandle(file);
+		return NULL;
+	}
+	// The view keeps the file open.
+	mapping = CreateFileMapping(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	CloseHandle(file);
+	if (mapping == NULL)
+		return NULL;
+	hdr = (const D2VINDEXHEADER *)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	CloseHandle(mapping);
+	if (hdr == NULL)
+		return NULL;
+
+	if (memcmp(hdr->magic, D2V_INDEX_MAGIC, sizeof(hdr->magic)) ||
+		hdr->d2v_size != (((unsigned __int64)attr.nFileSizeHigh << 32) | attr.nFileSizeLow) ||
+		CompareFileTime(&hdr->d2v_time, &attr.ftLastWriteTime) ||
+		hdr->gops == 0 || hdr->frames == 0 ||
+		(unsigned __int64)size.QuadPart != sizeof(D2VINDEXHEADER) +
+			(unsigned __int64)hdr->gops * sizeof(D2VINDEXGOP) + hdr->frames)
+	{
+		UnmapViewOfFile(hdr);
+		return NULL;
+	}
+	// The GOPs have to cover the frames in order.
+	gop = (const D2VINDEXGOP *)(hdr + 1);
+	for (i = 0, frames = 0; i < hdr->gops; i++)
+	{
+		if (gop[i].first_frame != frames || gop[i].frames == 0 || !(gop[i].info & 0x800))
+			break;
+		frames += gop[i].frames;
+	}
+	if (i < hdr->gops || frames != hdr->frames)
+	{
+		UnmapViewOfFile(hdr);
+		return NULL;
+	}
+	return hdr;
+}
+
 // Open function modified by Donald Graft as part of fix for dropped frames and random frame access.
 int CMPEG2Decoder::Open(const char *path)
 {
@@ -85,9 +167,15 @@ int CMPEG2Decoder::Open(const char *path)
 	int vob_id, cell_id;
 	__int64 position;
     int HadI;
+	const D2VINDEXHEADER *bin;
+	const D2VINDEXGOP *bin_gop = NULL;
+	const unsigned char *bin_flags = NULL;
 
 	CMPEG2Decoder* out = this;
 
+	// for the GOP workers
+	D2V_Path = _strdup(path);
+
 	out->VF_File = fopen(path, "r");
 	if (fgets(ID, 79, out->VF_File)==NULL)
 		return 1;
@@ -186,7 +274,7 @@ int CMPEG2Decoder::Open(const char *path)
 			break;
 
 		case IDCT_SSE2MMX:
-			idctFunc = SSE2MMX_IDCT;
+			idctFunc = SSE2_IDCT;
 			if (!cpu.sse2mmx)
 			{
 				IDCT_Flag = IDCT_SSEMMX;
@@ -219,7 +307,7 @@ int CMPEG2Decoder::Open(const char *path)
 	}
 
 	File_Flag = 0;
-	_lseeki64(Infile[0], 0, SEEK_SET);
+	Reader.Seek(Infile[0], 0);
 	Initialize_Buffer();
 
 	do
@@ -303,6 +391,17 @@ int CMPEG2Decoder::Open(const char *path)
 	saved_active = auxFrame1;
 	saved_store = auxFrame2;
 
+	// Cached frames are laid out like auxFrame1.
+	if (cache_mb > 0)
+	{
+		int bytes = auxFrame1->ypitch * auxFrame1->yheight + 2 * auxFrame1->uvpitch * auxFrame1->uvheight;
+		FrameCacheSize = (int)(((__int64)cache_mb << 20) / bytes);
+		if (FrameCacheSize > 0)
+			FrameCache = (CACHEDFRAME *)calloc(FrameCacheSize, sizeof(CACHEDFRAME));
+		if (FrameCache == NULL)
+			FrameCacheSize = 0;
+	}
+
 	fscanf(out->VF_File, "Field_Operation=%d\n", &FO_Flag);
 	fscanf(out->VF_File, "Frame_Rate=%d (%u/%u)\n", &(out->VF_FrameRate), &(out->VF_FrameRate_Num), &(out->VF_FrameRate_Den));
 	fscanf(out->VF_File, "Location=%d,%X,%d,%X\n", &i, &j, &i, &j);
@@ -320,11 +419,31 @@ int CMPEG2Decoder::Open(const char *path)
 	int DirectAccessSize = 1000000;
 	int FrameListSize = 1000000;
 
-	fgets(buf, 2047, out->VF_File);
-	buf_p = buf;
+	// The frame lines come from the binary index if DGIndex wrote one.
+	bin = Map_D2V_Index(path);
+	if (bin != NULL)
+	{
+		bin_gop = (const D2VINDEXGOP *)(bin + 1);
+		bin_flags = (const unsigned char *)(bin_gop + bin->gops);
+	}
+	else
+	{
+		fgets(buf, 2047, out->VF_File);
+		buf_p = buf;
+	}
 	while (true)
 	{
-		sscanf(buf_p, "%x", &type);
+		if (bin != NULL)
+		{
+			if (film == bin->frames)
+				break;
+			if (gop < bin->gops && film == bin_gop[gop].first_frame)
+				type = bin_gop[gop].info;
+			else
+				type = bin_flags[film];
+		}
+		else
+			sscanf(buf_p, "%x", &type);
 		if (type == 0xff)
 			break;
 		if (type & 0x800)	// New I-frame line start.
@@ -337,24 +456,37 @@ int CMPEG2Decoder::Open(const char *path)
 			}
 			GOPList[gop] = reinterpret_cast<GOPLIST*>(calloc(1, sizeof(GOPLIST)));
 			GOPList[gop]->number = film;
-			while (*buf_p++ != ' ');
-			sscanf(buf_p, "%d", &(GOPList[gop]->matrix));
-			while (*buf_p++ != ' ');
-			sscanf(buf_p, "%d", &(GOPList[gop]->file));
-			while (*buf_p++ != ' ');
-			position = _atoi64(buf_p);
-			while (*buf_p++ != ' ');
-			sscanf(buf_p, "%d", &(GOPList[gop]->I_count));
-			while (*buf_p++ != ' ');
-			sscanf(buf_p, "%d %d", &vob_id, &cell_id);
-			while (*buf_p++ != ' ');
-			while (*buf_p++ != ' ');
+			if (bin != NULL)
+			{
+				GOPList[gop]->matrix = bin_gop[gop].matrix;
+				GOPList[gop]->file = bin_gop[gop].file;
+				GOPList[gop]->I_count = bin_gop[gop].I_count;
+				position = bin_gop[gop].position;
+			}
+			else
+			{
+				while (*buf_p++ != ' ');
+				sscanf(buf_p, "%d", &(GOPList[gop]->matrix));
+				while (*buf_p++ != ' ');
+				sscanf(buf_p, "%d", &(GOPList[gop]->file));
+				while (*buf_p++ != ' ');
+				position = _atoi64(buf_p);
+				while (*buf_p++ != ' ');
+				sscanf(buf_p, "%d", &(GOPList[gop]->I_count));
+				while (*buf_p++ != ' ');
+				sscanf(buf_p, "%d %d", &vob_id, &cell_id);
+				while (*buf_p++ != ' ');
+				while (*buf_p++ != ' ');
+			}
 			GOPList[gop]->position = position;
 			GOPList[gop]->closed = (type & 0x400) ? 1 : 0;
 			GOPList[gop]->progressive = (type & 0x200) ? 1 : 0;
 			gop++;
 
-			sscanf(buf_p, "%x", &type);
+			if (bin != NULL)
+				type = bin_flags[film];
+			else
+				sscanf(buf_p, "%x", &type);
 		}
 		tff = (type & 0x2) >> 1;
 		if (FO_Flag == FO_RAW)
@@ -511,6 +643,8 @@ int CMPEG2Decoder::Open(const char *path)
 
 		film++;
 
+		if (bin != NULL)
+			continue;
 		// Move to the next flags digit or get the next line.
 		while (*buf_p != '\n' && *buf_p != ' ') buf_p++;
 		if (*buf_p == '\n')
@@ -520,9 +654,21 @@ int CMPEG2Decoder::Open(const char *path)
 		}
 		else buf_p++;
 	}
+	if (bin != NULL)
+		UnmapViewOfFile(bin);
 // dprintf("gop = %d, film = %d, ntsc = %d\n", gop, film, ntsc);
 	out->VF_GOPLimit = gop;
 
+	// A frame belongs to the last GOP starting at or before it.
+	GOPIndex = (unsigned int *)malloc(max(film, 1) * sizeof(unsigned int));
+	GOPIndexSize = film;
+	for (i = 0, j = 0; i < film; i++)
+	{
+		while (j + 1 < gop && i >= GOPList[j+1]->number)
+			j++;
+		GOPIndex[i] = j;
+	}
+
 	if (FO_Flag==FO_FILM)
 	{
 		while (FrameList[mapping-1].top >= film)
@@ -554,7 +700,7 @@ int CMPEG2Decoder::Open(const char *path)
 	// (due to an open GOP). This will be used to avoid displaying these
 	// bad frames.
 	File_Flag = 0;
-	_lseeki64(Infile[File_Flag], GOPList[0]->position, SEEK_SET);
+	Reader.Seek(Infile[File_Flag], GOPList[0]->position);
 	Initialize_Buffer();
 
 	closed_gop = -1;
@@ -597,6 +743,8 @@ int CMPEG2Decoder::Open(const char *path)
 			BadStartingFrames = i;
 		}
 	}
+
+	Start_Slice_Workers();
 	return 0;
 }
 
@@ -619,6 +767,18 @@ __try
 	if (frame < BadStartingFrames) frame = BadStartingFrames;
 	requested_frame = frame;
 
+	// A frame delivered before comes from the cache. The decoder is left where
+	// it stopped, so prev_frame stays and a short forward seek after this one
+	// still plays on from there.
+	if (CacheLookup(frame, dst))
+		return;
+
+	if (gops > 1 && GOP_Decode(frame, dst))
+	{
+		CacheStore(frame, dst);
+		return;
+	}
+
 	// Decide whether to use random access or linear play to reach the
 	// requested frame. If the seek is just a few frames forward, it will
 	// be faster to play linearly to get there. This greatly speeds things up
@@ -707,6 +867,7 @@ __try
 					CopyTop(saved_active, dst);
 				}
 			}
+			CacheStore(frame, dst);
 		}
 		prev_frame = requested_frame;
 		return;
@@ -717,13 +878,7 @@ __try
 	f = max(FrameList[frame].top, FrameList[frame].bottom);
 
 	// Determine the GOP that the requested frame is in.
-	for (gop = 0; gop < VF_GOPLimit-1; gop++)
-	{
-		if (f >= GOPList[gop]->number && f < GOPList[gop+1]->number)
-		{
-			break;
-		}
-	}
+	gop = GetGOP(f);
 
 	// Back off by one GOP if required. This ensures enough frames will
 	// be decoded that the requested frame is guaranteed to be decodable.
@@ -748,9 +903,7 @@ __try
 
 	// Seek in the stream to the GOP to start decoding with.
 	File_Flag = GOPList[gop]->file;
-	_lseeki64(Infile[GOPList[gop]->file],
-		      GOPList[gop]->position,
-			  SEEK_SET);
+	Reader.Seek(Infile[GOPList[gop]->file], GOPList[gop]->position);
 	Initialize_Buffer();
 
 	// Start decoding. Stop when the requested frame is decoded.
@@ -858,6 +1011,7 @@ __try
 			CopyTop(saved_active, dst);
 		}
 	}
+	CacheStore(frame, dst);
 	return;
 }
 __except(EXCEPTION_EXECUTE_HANDLER)
@@ -871,12 +1025,18 @@ void CMPEG2Decoder::Close()
 	int i;
 	CMPEG2Decoder* in = this;
 
+	Stop_GOP_Workers();
+	if (D2V_Path != NULL) free(D2V_Path);
+	D2V_Path = NULL;
+
 	if (in->VF_File)
     {
 		fclose(in->VF_File);
         in->VF_File = NULL;
     }
 
+	Stop_Slice_Workers();
+	Reader.Reset();
 	while (File_Limit)
 	{
 		File_Limit--;
@@ -917,6 +1077,308 @@ void CMPEG2Decoder::Close()
 	if (FrameList != NULL) free(FrameList);
 
 	if (DirectAccess != NULL) free(DirectAccess);
+
+	if (GOPIndex != NULL) free(GOPIndex);
+	GOPIndex = NULL;
+	GOPIndexSize = 0;
+
+	if (FrameCache != NULL)
+	{
+		for (i=0; i<FrameCacheSize; ++i)
+		{
+			if (FrameCache[i].pict != NULL) destroy_YV12PICT(FrameCache[i].pict);
+		}
+		free(FrameCache);
+	}
+	FrameCache = NULL;
+	FrameCacheSize = 0;
+}
+
+bool CMPEG2Decoder::CacheLookup(DWORD frame, YV12PICT *dst)
+{
+	int i;
+
+	for (i=0; i<FrameCacheSize; i++)
+	{
+		if (FrameCache[i].pict != NULL && FrameCache[i].frame == frame)
+		{
+			FrameCache[i].used = ++FrameCacheClock;
+			CopyAll(FrameCache[i].pict, dst);
+			dst->pf = FrameCache[i].pict->pf;
+			return true;
+		}
+	}
+	return false;
+}
+
+void CMPEG2Decoder::CacheStore(DWORD frame, YV12PICT *src)
+{
+	int i, slot = -1;
+
+	// Unused slots have never been used, so they go before any other.
+	for (i=0; i<FrameCacheSize; i++)
+	{
+		if (FrameCache[i].pict != NULL && FrameCache[i].frame == frame)
+		{
+			slot = i;
+			break;
+		}
+		if (slot < 0 || FrameCache[i].used < FrameCache[slot].used)
+			slot = i;
+	}
+	if (slot < 0)
+		return;
+
+	if (FrameCache[slot].pict == NULL)
+		FrameCache[slot].pict = New_Output_Frame();
+	CopyAll(src, FrameCache[slot].pict);
+	FrameCache[slot].pict->pf = src->pf;
+	FrameCache[slot].frame = frame;
+	FrameCache[slot].used = ++FrameCacheClock;
+}
+
+// a frame in the layout Decode() delivers
+YV12PICT *CMPEG2Decoder::New_Output_Frame()
+{
+	return create_YV12PICT(Coded_Picture_Height, Coded_Picture_Width,
+		(upConv > 0 && chroma_format == 1) ? chroma_format+1 : chroma_format);
+}
+
+bool CMPEG2Decoder::GOP_Decode(DWORD frame, YV12PICT *dst)
+{
+	GOPSLOT *slot;
+	DWORD i;
+
+	if (GOPWorkers == 0)
+	{
+		// Wait for the pass to show itself before opening the workers.
+		if (frame != GOPLast + 1 || !Start_GOP_Workers())
+		{
+			GOPLast = frame;
+			return false;
+		}
+	}
+
+	EnterCriticalSection(&GOPLock);
+	if (!GOPActive || frame < GOPHead || frame >= GOPHead + GOPWindow)
+	{
+		// Only a linear pass is worth moving the window for. Other frames,
+		// and short steps back that the cache didn't have, are left to this
+		// decoder.
+		if (frame != GOPLast + 1 || (GOPActive && frame < GOPHead && frame + GOPWindow > GOPHead))
+		{
+			GOPLast = frame;
+			LeaveCriticalSection(&GOPLock);
+			return false;
+		}
+		GOPActive = true;
+		GOPGeneration++;
+		GOPNext = frame;
+		for (i=0; i<GOPWindow; i++)
+			GOPSlot[i].ready = false;
+	}
+	GOPLast = frame;
+	GOPHead = frame;
+	Wake_GOP_Workers();
+
+	slot = &GOPSlot[frame % GOPWindow];
+	while (!slot->ready || slot->frame != frame)
+	{
+		LeaveCriticalSection(&GOPLock);
+		WaitForSingleObject(GOPReady, INFINITE);
+		EnterCriticalSection(&GOPLock);
+	}
+	LeaveCriticalSection(&GOPLock);
+
+	// Nothing reuses the slot before the window moves on.
+	CopyAll(slot->pict, dst);
+	dst->pf = slot->pict->pf;
+	return true;
+}
+
+bool CMPEG2Decoder::Start_GOP_Workers()
+{
+	int i;
+	DWORD j, id;
+	CMPEG2Decoder *w;
+
+	// One GOP for every worker and one being delivered.
+	GOPWindow = (min(gops, MAX_GOP_THREADS) + 1) * (VF_FrameLimit / VF_GOPLimit + 1);
+	GOPSlot = (GOPSLOT *)calloc(GOPWindow, sizeof(GOPSLOT));
+	if (GOPSlot == NULL)
+		return false;
+	for (j=0; j<GOPWindow; j++)
+		GOPSlot[j].pict = New_Output_Frame();
+
+	InitializeCriticalSection(&GOPLock);
+	GOPReady = CreateEvent(NULL, FALSE, FALSE, NULL);
+	GOPQuit = false;
+	GOPActive = false;
+	GOPGeneration = 0;
+
+	for (i=0; i<gops && i<MAX_GOP_THREADS; i++)
+	{
+		w = new CMPEG2Decoder;
+		w->iPP = iPP;
+		w->iCC = iCC;
+		w->showQ = showQ;
+		w->fastMC = fastMC;
+		w->upConv = upConv;
+		w->i420 = i420;
+		w->moderate_h = moderate_h;
+		w->moderate_v = moderate_v;
+		w->refinit = refinit;
+		w->fpuinit = fpuinit;
+		w->cache_mb = 0;
+		if (w->Open(D2V_Path))
+		{
+			// as in MPEG2Source, what Open() allocated is lost
+			if (w->VF_File) fclose(w->VF_File);
+			delete w;
+			break;
+		}
+		// set by MPEG2Source after Open()
+		w->AVSenv = AVSenv;
+		w->pp_mode = pp_mode;
+		w->IDCT_Flag = IDCT_Flag;
+		w->idctFunc = idctFunc;
+
+		w->GOPOwner = this;
+		w->GOPScratch = w->New_Output_Frame();
+		GOPWorker[i] = w;
+		GOPWake[i] = CreateEvent(NULL, FALSE, FALSE, NULL);
+		GOPThread[i] = CreateThread(NULL, 0, GOP_Worker, w, 0, &id);
+		GOPWorkers++;
+	}
+	if (GOPWorkers == 0)
+	{
+		// Don't try again on every frame.
+		gops = 0;
+		Stop_GOP_Workers();
+		return false;
+	}
+	return true;
+}
+
+void CMPEG2Decoder::Stop_GOP_Workers()
+{
+	int i;
+	DWORD j;
+
+	if (GOPSlot == NULL)
+		return;
+
+	EnterCriticalSection(&GOPLock);
+	GOPQuit = true;
+	Wake_GOP_Workers();
+	LeaveCriticalSection(&GOPLock);
+	for (i=0; i<GOPWorkers; i++)
+	{
+		WaitForSingleObject(GOPThread[i], INFINITE);
+		CloseHandle(GOPThread[i]);
+		CloseHandle(GOPWake[i]);
+		destroy_YV12PICT(GOPWorker[i]->GOPScratch);
+		GOPWorker[i]->Close();
+		delete GOPWorker[i];
+	}
+	GOPWorkers = 0;
+
+	for (j=0; j<GOPWindow; j++)
+		destroy_YV12PICT(GOPSlot[j].pict);
+	free(GOPSlot);
+	GOPSlot = NULL;
+	CloseHandle(GOPReady);
+	DeleteCriticalSection(&GOPLock);
+}
+
+// Called with GOPLock held.
+void CMPEG2Decoder::Wake_GOP_Workers()
+{
+	int i;
+
+	for (i=0; i<GOPWorkers; i++)
+		SetEvent(GOPWake[i]);
+}
+
+DWORD WINAPI CMPEG2Decoder::GOP_Worker(LPVOID arg)
+{
+	CMPEG2Decoder *w = (CMPEG2Decoder *)arg;
+	CMPEG2Decoder *dec = w->GOPOwner;
+	HANDLE wake;
+	DWORD f, last, gop, generation;
+	GOPSLOT *slot;
+	YV12PICT *dst;
+	int i;
+
+	for (i=0; dec->GOPWorker[i] != w; i++);
+	wake = dec->GOPWake[i];
+
+#define GOP_WAIT() \
+	{ \
+		LeaveCriticalSection(&dec->GOPLock); \
+		WaitForSingleObject(wake, INFINITE); \
+		EnterCriticalSection(&dec->GOPLock); \
+	}
+
+	EnterCriticalSection(&dec->GOPLock);
+	while (!dec->GOPQuit)
+	{
+		if (!dec->GOPActive || dec->GOPNext >= dec->VF_FrameLimit ||
+			dec->GOPNext >= dec->GOPHead + dec->GOPWindow)
+		{
+			GOP_WAIT();
+			continue;
+		}
+
+		// Take the frames of the next GOP. Decode() makes the first of them
+		// a random access, which backs off a GOP if it is open, and plays
+		// linearly through the rest.
+		f = dec->GOPNext;
+		gop = dec->GetGOP(max(dec->FrameList[f].top, dec->FrameList[f].bottom));
+		for (last = f; last + 1 < dec->VF_FrameLimit; last++)
+		{
+			if (dec->GetGOP(max(dec->FrameList[last+1].top, dec->FrameList[last+1].bottom)) != gop)
+				break;
+		}
+		dec->GOPNext = last + 1;
+		generation = dec->GOPGeneration;
+
+		for (; f <= last; f++)
+		{
+			slot = &dec->GOPSlot[f % dec->GOPWindow];
+			// The slot is still written while the frame before in it is
+			// decoded for a window that has moved on.
+			while (!dec->GOPQuit && generation == dec->GOPGeneration &&
+				   (f >= dec->GOPHead + dec->GOPWindow || (f >= dec->GOPHead && slot->writing)))
+				GOP_WAIT();
+			if (dec->GOPQuit || generation != dec->GOPGeneration)
+				break;
+
+			if (f >= dec->GOPHead)
+			{
+				dst = slot->pict;
+				slot->frame = f;
+				slot->ready = false;
+				slot->writing = true;
+			}
+			else
+				dst = w->GOPScratch;	// skipped, but the next frames need it decoded
+			LeaveCriticalSection(&dec->GOPLock);
+			w->Decode(f, dst);
+			EnterCriticalSection(&dec->GOPLock);
+			if (dst != w->GOPScratch)
+			{
+				slot->writing = false;
+				slot->ready = (generation == dec->GOPGeneration);
+				SetEvent(dec->GOPReady);
+				dec->Wake_GOP_Workers();
+			}
+		}
+	}
+	LeaveCriticalSection(&dec->GOPLock);
+
+#undef GOP_WAIT
+	return 0;
 }
 
 // mmx YV12 framecpy by MarcFD 25 nov 2002 (okay the macros are ugly, but it's fast ^^)
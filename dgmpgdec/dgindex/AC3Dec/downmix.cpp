@@ -20,6 +20,7 @@
  */
 
 #include <math.h>
+#include <emmintrin.h>
 #include "../global.h"
 #include "ac3.h"
 
@@ -358,6 +359,107 @@ static void downmix_2f_1r_to_2ch_dolby(double gain, stream_samples_t samples, si
 	}
 }
 
+// Stands in for the channels a mode doesn't have.
+static __declspec(align(16)) double zero_samples[256];
+
+static __forceinline __m128d mix_sse2(__m128d level, __m128d front, __m128d lfe, __m128d clev, __m128d centre,
+									  __m128d slev, __m128d sur, __m128d gain)
+{
+	return _mm_mul_pd(_mm_add_pd(_mm_add_pd(_mm_mul_pd(level, _mm_add_pd(front, lfe)),
+											_mm_mul_pd(clev, centre)),
+								 _mm_mul_pd(slev, sur)), gain);
+}
+
+/* The downmixes without the Dolby Surround filter in one loop, with left
+   and right in the two halves of a register. The missing channels mix in
+   as zeros and the sums are done in the same order as above, so the
+   results are the same. cvtpd2dq rounds like fistp and packssdw saturates
+   like SaturateRound(). */
+static void downmix_sse2(double gain, bsi_t* bsi, stream_samples_t samples, sint_16 *s16_samples)
+{
+	double level = 0.4143, clev = 0.0, slev = 0.0;
+	double *left, *right, *centre, *left_sur, *right_sur, *lfe;
+	__m128d k, c, s, g, l, r, ce, ls, rs, lf, lo, hi;
+	__m128i out;
+	int j;
+
+	left = right = samples[0];
+	centre = left_sur = right_sur = lfe = zero_samples;
+
+	switch (bsi->acmod)
+	{
+		case 7:
+			centre    = samples[1];
+			right     = samples[2];
+			left_sur  = samples[3];
+			right_sur = samples[4];
+			if (bsi->lfeon)
+				lfe = samples[5];
+			clev = cmixlev_lut[bsi->cmixlev];
+			slev = smixlev_lut[bsi->surmixlev];
+			break;
+
+		case 6:
+			right     = samples[1];
+			left_sur  = samples[2];
+			right_sur = samples[3];
+			slev = smixlev_lut[bsi->surmixlev];
+			break;
+
+		case 5:
+			centre    = samples[1];
+			right     = samples[2];
+			left_sur  = right_sur = samples[3];
+			clev = cmixlev_lut[bsi->cmixlev];
+			slev = smixlev_lut[bsi->surmixlev];
+			break;
+
+		case 4:
+			right     = samples[1];
+			left_sur  = right_sur = samples[2];
+			slev = smixlev_lut[bsi->surmixlev];
+			break;
+
+		case 3:
+			centre    = samples[1];
+			right     = samples[2];
+			clev = cmixlev_lut[bsi->cmixlev];
+			break;
+
+		case 2:
+			right     = samples[1];
+			level = 1.0;
+			break;
+
+		default:
+			level = 0.7071;
+			break;
+	}
+
+	k = _mm_set1_pd(level);
+	c = _mm_set1_pd(clev);
+	s = _mm_set1_pd(slev);
+	g = _mm_set1_pd(gain);
+
+	for (j = 0; j < 256; j += 2)
+	{
+		l  = _mm_loadu_pd(left + j);
+		r  = _mm_loadu_pd(right + j);
+		ce = _mm_loadu_pd(centre + j);
+		ls = _mm_loadu_pd(left_sur + j);
+		rs = _mm_loadu_pd(right_sur + j);
+		lf = _mm_loadu_pd(lfe + j);
+
+		lo = mix_sse2(k, _mm_unpacklo_pd(l, r), _mm_unpacklo_pd(lf, lf), c, _mm_unpacklo_pd(ce, ce),
+					  s, _mm_unpacklo_pd(ls, rs), g);
+		hi = mix_sse2(k, _mm_unpackhi_pd(l, r), _mm_unpackhi_pd(lf, lf), c, _mm_unpackhi_pd(ce, ce),
+					  s, _mm_unpackhi_pd(ls, rs), g);
+
+		out = _mm_unpacklo_epi64(_mm_cvtpd_epi32(lo), _mm_cvtpd_epi32(hi));
+		_mm_storel_epi64((__m128i *)(s16_samples + 2*j), _mm_packs_epi32(out, out));
+	}
+}
+
 void downmix(audblk_t *audblk, bsi_t* bsi, stream_samples_t samples, sint_16 *s16_samples)
 {
 	double gain;
@@ -367,6 +469,12 @@ void downmix(audblk_t *audblk, bsi_t* bsi, stream_samples_t samples, sint_16 *s1
 	else
 		gain = 32768.0 * drc[audblk->dynrng] * PreScale_Ratio;
 
+	if (cpu.sse2 && !(DSDown_Flag && bsi->acmod >= 4))
+	{
+		downmix_sse2(gain, bsi, samples, s16_samples);
+		return;
+	}
+
 	switch (bsi->acmod)
 	{
 		// 3/2
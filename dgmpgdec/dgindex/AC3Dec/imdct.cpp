@@ -20,6 +20,8 @@
  */
 
 #include <math.h>
+#include <emmintrin.h>
+#include "../global.h"
 #include "ac3.h"
 
 #define M_PI	3.1415926535897932384626433832795
@@ -27,6 +29,8 @@
 
 void imdct_do_256(double data[], double delay[]);
 void imdct_do_512(double data[], double delay[]);
+void imdct_do_256_sse2(double data[], float delay[]);
+void imdct_do_512_sse2(double data[], float delay[]);
 
 typedef struct complex_s
 {
@@ -118,6 +122,27 @@ static double window[] = {
 	0.99999, 0.99999, 0.99999, 1.00000, 1.00000, 1.00000, 1.00000, 1.00000,
 	1.00000, 1.00000, 1.00000, 1.00000, 1.00000, 1.00000, 1.00000, 1.00000 };
 
+/* Single precision copies for the SSE2 transforms. The FFT buffer is
+   split into real and imaginary parts, the twiddle factors of pass m are
+   at (1<<m) + k. The window and the delay line are doubled, which saves
+   the multiply by 2.0 of the output. */
+static __declspec(align(16)) float fbuf_re[128];
+static __declspec(align(16)) float fbuf_im[128];
+static __declspec(align(16)) float fw_re[128];
+static __declspec(align(16)) float fw_im[128];
+static __declspec(align(16)) float fxcos1[128];
+static __declspec(align(16)) float fxsin1[128];
+static __declspec(align(16)) float fxcos2[64];
+static __declspec(align(16)) float fxsin2[64];
+static __declspec(align(16)) float fwindow[256];
+static __declspec(align(16)) float fwindow_rev[256];
+static __declspec(align(16)) float fdelay[6][256];
+
+// Set from FastAC3_Flag when a stream starts, so the delay lines stay with
+// one IMDCT. The SSE2 one is single precision and about 0.24% of the
+// samples come out 1 off, so it is opt-in.
+static bool fast_imdct;
+
 static complex_t cmplx_mult(complex_t a, complex_t b)
 {
 	complex_t ret;
@@ -169,10 +194,33 @@ void imdct_init()
 		{
 			w[i][k] = current_angle;
 			current_angle = cmplx_mult(current_angle, angle_step);
+
+			fw_re[(1 << i) + k] = (float) w[i][k].real;
+			fw_im[(1 << i) + k] = (float) w[i][k].imag;
 		}
 	}
 
+	for (i = 0; i < 128; i++)
+	{
+		fxcos1[i] = (float) xcos1[i];
+		fxsin1[i] = (float) xsin1[i];
+	}
+
+	for (i = 0; i < 64; i++)
+	{
+		fxcos2[i] = (float) xcos2[i];
+		fxsin2[i] = (float) xsin2[i];
+	}
+
+	for (i = 0; i < 256; i++)
+	{
+		fwindow[i] = (float) (2.0 * window[i]);
+		fwindow_rev[i] = (float) (2.0 * window[255 - i]);
+	}
+
 	ZeroMemory(&delay, sizeof(delay));
+	ZeroMemory(&fdelay, sizeof(fdelay));
+	fast_imdct = cpu.sse2 && FastAC3_Flag;
 }
 
 void imdct_do_512(double data[], double delay[])
@@ -397,10 +445,233 @@ void imdct_do_256(double data[], double delay[])
 	}
 }
 
+/* The SSE2 transforms below do the same as the two above in single
+   precision, four butterflies or samples at a time. A long block takes
+   about a third of the time, a short one half. The output differs from
+   that of the double precision ones by a few hundredths of a 16 bit step,
+   so after rounding a sample is at most 1 off. */
+
+#define SIGN_MASK(a, b, c, d)	_mm_castsi128_ps(_mm_set_epi32((int) ((unsigned) (d) << 31), (int) ((unsigned) (c) << 31), \
+								(int) ((unsigned) (b) << 31), (int) ((unsigned) (a) << 31)))
+
+static __forceinline __m128 reverse(__m128 x)
+{
+	return _mm_shuffle_ps(x, x, _MM_SHUFFLE(0,1,2,3));
+}
+
+// Eight doubles as floats, the even ones in *even and the odd ones in *odd.
+static __forceinline void load_deinterleave(const double *p, __m128 *even, __m128 *odd)
+{
+	__m128 a = _mm_movelh_ps(_mm_cvtpd_ps(_mm_loadu_pd(p)), _mm_cvtpd_ps(_mm_loadu_pd(p + 2)));
+	__m128 b = _mm_movelh_ps(_mm_cvtpd_ps(_mm_loadu_pd(p + 4)), _mm_cvtpd_ps(_mm_loadu_pd(p + 6)));
+
+	*even = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2,0,2,0));
+	*odd = _mm_shuffle_ps(a, b, _MM_SHUFFLE(3,1,3,1));
+}
+
+// In place FFT of n (64 or 128) bit reversed points.
+static void fft_sse2(float *re, float *im, int n)
+{
+	const __m128 sign_13 = SIGN_MASK(0, 1, 0, 1);
+	const __m128 sign_23 = SIGN_MASK(0, 0, 1, 1);
+	__m128 r, i, tr, ti, wr, wi;
+	int j, k, p, q, two_m;
+
+	// The first two passes in registers, on groups of four points. The
+	// twiddle factor w[1][1] is -j.
+	for (j = 0; j < n; j += 4)
+	{
+		r = _mm_load_ps(re + j);
+		i = _mm_load_ps(im + j);
+		r = _mm_add_ps(_mm_shuffle_ps(r, r, _MM_SHUFFLE(2,2,0,0)),
+					   _mm_xor_ps(_mm_shuffle_ps(r, r, _MM_SHUFFLE(3,3,1,1)), sign_13));
+		i = _mm_add_ps(_mm_shuffle_ps(i, i, _MM_SHUFFLE(2,2,0,0)),
+					   _mm_xor_ps(_mm_shuffle_ps(i, i, _MM_SHUFFLE(3,3,1,1)), sign_13));
+
+		tr = _mm_shuffle_ps(r, i, _MM_SHUFFLE(3,3,2,2));
+		ti = _mm_shuffle_ps(i, r, _MM_SHUFFLE(3,3,2,2));
+		tr = _mm_shuffle_ps(tr, tr, _MM_SHUFFLE(2,0,2,0));
+		ti = _mm_xor_ps(_mm_shuffle_ps(ti, ti, _MM_SHUFFLE(2,0,2,0)), sign_13);
+		r = _mm_add_ps(_mm_shuffle_ps(r, r, _MM_SHUFFLE(1,0,1,0)), _mm_xor_ps(tr, sign_23));
+		i = _mm_add_ps(_mm_shuffle_ps(i, i, _MM_SHUFFLE(1,0,1,0)), _mm_xor_ps(ti, sign_23));
+		_mm_store_ps(re + j, r);
+		_mm_store_ps(im + j, i);
+	}
+
+	for (two_m = 4; two_m < n; two_m <<= 1)
+	{
+		for (j = 0; j < n; j += two_m << 1)
+		{
+			for (k = 0; k < two_m; k += 4)
+			{
+				p = j + k;
+				q = p + two_m;
+				wr = _mm_load_ps(fw_re + two_m + k);
+				wi = _mm_load_ps(fw_im + two_m + k);
+				r = _mm_load_ps(re + q);
+				i = _mm_load_ps(im + q);
+				tr = _mm_sub_ps(_mm_mul_ps(r, wr), _mm_mul_ps(i, wi));
+				ti = _mm_add_ps(_mm_mul_ps(i, wr), _mm_mul_ps(r, wi));
+				r = _mm_load_ps(re + p);
+				i = _mm_load_ps(im + p);
+				_mm_store_ps(re + p, _mm_add_ps(r, tr));
+				_mm_store_ps(im + p, _mm_add_ps(i, ti));
+				_mm_store_ps(re + q, _mm_sub_ps(r, tr));
+				_mm_store_ps(im + q, _mm_sub_ps(i, ti));
+			}
+		}
+	}
+}
+
+// Post IFFT complex multiply plus IFFT complex conjugate
+static void post_twiddle_sse2(float *re, float *im, const float *xcos, const float *xsin, int n)
+{
+	__m128 r, i, c, s;
+	int j;
+
+	for (j = 0; j < n; j += 4)
+	{
+		r = _mm_load_ps(re + j);
+		i = _mm_load_ps(im + j);
+		c = _mm_load_ps(xcos + j);
+		s = _mm_load_ps(xsin + j);
+		_mm_store_ps(re + j, _mm_add_ps(_mm_mul_ps(r, c), _mm_mul_ps(i, s)));
+		_mm_store_ps(im + j, _mm_sub_ps(_mm_mul_ps(r, s), _mm_mul_ps(i, c)));
+	}
+}
+
+// Eight outputs, interleaved from a and b.
+static __forceinline void window_out(double *data, const float *delay, const float *win, __m128 a, __m128 b)
+{
+	__m128 lo = _mm_add_ps(_mm_mul_ps(_mm_unpacklo_ps(a, b), _mm_load_ps(win)), _mm_load_ps(delay));
+	__m128 hi = _mm_add_ps(_mm_mul_ps(_mm_unpackhi_ps(a, b), _mm_load_ps(win + 4)), _mm_load_ps(delay + 4));
+
+	_mm_storeu_pd(data,     _mm_cvtps_pd(lo));
+	_mm_storeu_pd(data + 2, _mm_cvtps_pd(_mm_movehl_ps(lo, lo)));
+	_mm_storeu_pd(data + 4, _mm_cvtps_pd(hi));
+	_mm_storeu_pd(data + 6, _mm_cvtps_pd(_mm_movehl_ps(hi, hi)));
+}
+
+static __forceinline void window_delay(float *delay, const float *win, __m128 a, __m128 b)
+{
+	_mm_store_ps(delay,     _mm_mul_ps(_mm_unpacklo_ps(a, b), _mm_load_ps(win)));
+	_mm_store_ps(delay + 4, _mm_mul_ps(_mm_unpackhi_ps(a, b), _mm_load_ps(win + 4)));
+}
+
+/* Window and convert to real valued signal, and fill the delay line. Both
+   transforms take the four quarters the same way, a forwards and b
+   backwards from the pointers given: out1 -a b, out2 -a b, delay1 -a b,
+   delay2 a -b. */
+static void window_sse2(double *data, float *delay,
+						const float *out1_a, const float *out1_b, const float *out2_a, const float *out2_b,
+						const float *dly1_a, const float *dly1_b, const float *dly2_a, const float *dly2_b)
+{
+	const __m128 sign = SIGN_MASK(1, 1, 1, 1);
+	int i;
+
+	for (i = 0; i < 64; i += 4)
+	{
+		window_out(data + 2*i, delay + 2*i, fwindow + 2*i,
+				   _mm_xor_ps(_mm_load_ps(out1_a + i), sign), reverse(_mm_load_ps(out1_b - i)));
+		window_out(data + 128 + 2*i, delay + 128 + 2*i, fwindow + 128 + 2*i,
+				   _mm_xor_ps(_mm_load_ps(out2_a + i), sign), reverse(_mm_load_ps(out2_b - i)));
+
+		window_delay(delay + 2*i, fwindow_rev + 2*i,
+					 _mm_xor_ps(_mm_load_ps(dly1_a + i), sign), reverse(_mm_load_ps(dly1_b - i)));
+		window_delay(delay + 128 + 2*i, fwindow_rev + 128 + 2*i,
+					 _mm_load_ps(dly2_a + i), _mm_xor_ps(reverse(_mm_load_ps(dly2_b - i)), sign));
+	}
+}
+
+void imdct_do_512_sse2(double data[], float delay[])
+{
+	__declspec(align(16)) float tmp_r[4], tmp_i[4];
+	__m128 xr, xi, c, s, unused;
+	int i, k;
+
+	// Pre IFFT complex multiply plus IFFT cmplx conjugate and bit reverse permutation
+	for (i = 0; i < 128; i += 4)
+	{
+		load_deinterleave(data + (i<<1), &xi, &unused);
+		load_deinterleave(data + 248 - (i<<1), &unused, &xr);
+		xr = reverse(xr);
+		c = _mm_load_ps(fxcos1 + i);
+		s = _mm_load_ps(fxsin1 + i);
+
+		_mm_store_ps(tmp_r, _mm_sub_ps(_mm_mul_ps(xr, c), _mm_mul_ps(xi, s)));
+		_mm_store_ps(tmp_i, _mm_xor_ps(_mm_add_ps(_mm_mul_ps(xi, c), _mm_mul_ps(xr, s)), SIGN_MASK(1, 1, 1, 1)));
+
+		for (k = 0; k < 4; k++)
+		{
+			fbuf_re[bit_reverse_512[i + k]] = tmp_r[k];
+			fbuf_im[bit_reverse_512[i + k]] = tmp_i[k];
+		}
+	}
+
+	fft_sse2(fbuf_re, fbuf_im, 128);
+	post_twiddle_sse2(fbuf_re, fbuf_im, fxcos1, fxsin1, 128);
+
+	window_sse2(data, delay,
+				fbuf_im + 64, fbuf_re + 60, fbuf_re, fbuf_im + 124,
+				fbuf_re + 64, fbuf_im + 60, fbuf_im, fbuf_re + 124);
+}
+
+void imdct_do_256_sse2(double data[], float delay[])
+{
+	float *buf_1_re = fbuf_re, *buf_1_im = fbuf_im;
+	float *buf_2_re = fbuf_re + 64, *buf_2_im = fbuf_im + 64;
+	float xp, xq;
+	int i, k, p, q;
+
+	// Pre IFFT complex multiply plus IFFT cmplx conjugate and bit reverse
+	// permutation
+	for (i = 0; i < 64; i++)
+	{
+		k = bit_reverse_256[i];
+
+		p = (127 - (i<<1))<<1;
+		q = i<<2;
+
+		xp = (float) data[p];
+		xq = (float) data[q];
+		buf_1_re[k] =   xp * fxcos2[i] - xq * fxsin2[i];
+		buf_1_im[k] = - xq * fxcos2[i] - xp * fxsin2[i];
+
+		xp = (float) data[p + 1];
+		xq = (float) data[q + 1];
+		buf_2_re[k] =   xp * fxcos2[i] - xq * fxsin2[i];
+		buf_2_im[k] = - xq * fxcos2[i] - xp * fxsin2[i];
+	}
+
+	fft_sse2(buf_1_re, buf_1_im, 64);
+	fft_sse2(buf_2_re, buf_2_im, 64);
+	post_twiddle_sse2(buf_1_re, buf_1_im, fxcos2, fxsin2, 64);
+	post_twiddle_sse2(buf_2_re, buf_2_im, fxcos2, fxsin2, 64);
+
+	window_sse2(data, delay,
+				buf_1_im, buf_1_re + 60, buf_1_re, buf_1_im + 60,
+				buf_2_re, buf_2_im + 60, buf_2_im, buf_2_re + 60);
+}
+
 void imdct(bsi_t *bsi, audblk_t *audblk, stream_samples_t samples)
 {
 	int i;
 
+	if (fast_imdct)
+	{
+		for (i = 0; i < bsi->nfchans; i++)
+		{
+			if (audblk->blksw[i])
+				imdct_do_256_sse2(samples[i], fdelay[i]);
+			else
+				imdct_do_512_sse2(samples[i], fdelay[i]);
+		}
+
+		if (bsi->lfeon)
+			imdct_do_512_sse2(samples[5], fdelay[5]);
+		return;
+	}
+
 	for(i=0; i<bsi->nfchans; i++)
 	{
 		if(audblk->blksw[i])
@@ -0,0 +1,273 @@
+/*
+ *  Audio worker thread for DGIndex
+ *
+ *  The packet parsers copy the payloads of the audio packets they demux
+ *  into a ring and carry on with the video. A worker thread takes them
+ *  out in order and does the AC3 decoding, LPCM byte swapping, sample
+ *  rate conversion and the file writes. There is one producer and one
+ *  consumer, so the ring needs no lock: each side only moves its own
+ *  index. The events are only used to sleep when the ring is full or
+ *  empty.
+ *
+ *  This file is part of DGIndex.
+ *
+ *  DGIndex is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  DGIndex is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with GNU Make; see the file COPYING.  If not, write to
+ *  the Free Software Foundation, 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+#include "global.h"
+#include "AC3Dec\ac3.h"
+
+// A power of two, and much larger than a PES packet.
+#define AUDIO_RING_SIZE		(4 << 20)
+// Jobs start on this boundary, so whatever is left at the end of the ring
+// has room for the header of a skip job.
+#define AUDIO_JOB_ALIGN		32
+#define ALIGN_JOB(n)		(((n) + AUDIO_JOB_ALIGN - 1) & ~(AUDIO_JOB_ALIGN - 1))
+
+#define AUDIO_JOB_SKIP		0
+
+typedef struct {
+	int				job;
+	int				id;
+	FILE			*file;
+	int				length;
+} AUDIOJOB;
+
+#define JOB_HEADER			ALIGN_JOB(sizeof(AUDIOJOB))
+
+static unsigned char *Ring;
+static volatile LONG Head;				// written by the parser
+static volatile LONG Tail;				// written by the worker
+static volatile LONG WorkerWaiting, ParserWaiting, Quit;
+static HANDLE hData, hRoom, hWorker;
+static LONG Pending;					// size of the job being filled
+
+static void SwapLPCM(unsigned char *buf, int size, unsigned char format)
+{
+	unsigned char tmp[12];
+	int i;
+
+	if ((format & 0xc0) == 0)
+	{
+		// 16-bit LPCM.
+		for (i = 0; i + 1 < size; i += 2)
+		{
+			tmp[0] = buf[i];
+			buf[i] = buf[i+1];
+			buf[i+1] = tmp[0];
+		}
+	}
+	else if ((format & 0x07) + 1 == 1)
+	{
+		// 24-bit mono
+		for (i = 0; i + 5 < size; i += 6)
+		{
+			tmp[0] = buf[i+4];
+			tmp[1] = buf[i+1];
+			tmp[2] = buf[i+0];
+			tmp[3] = buf[i+5];
+			tmp[4] = buf[i+3];
+			tmp[5] = buf[i+2];
+			memcpy(&buf[i], tmp, 6);
+		}
+	}
+	else
+	{
+		// 24-bit stereo
+		for (i = 0; i + 11 < size; i += 12)
+		{
+			tmp[0] = buf[i+8];
+			tmp[1] = buf[i+1];
+			tmp[2] = buf[i+0];
+			tmp[3] = buf[i+9];
+			tmp[4] = buf[i+3];
+			tmp[5] = buf[i+2];
+			tmp[6] = buf[i+10];
+			tmp[7] = buf[i+5];
+			tmp[8] = buf[i+4];
+			tmp[9] = buf[i+11];
+			tmp[10] = buf[i+7];
+			tmp[11] = buf[i+6];
+			memcpy(&buf[i], tmp, 12);
+		}
+	}
+}
+
+// Writes the samples of a decoded track, dropping the leading ones while
+// the track is ahead of the video (negative delay).
+static void WriteSamples(AudioStream *a, unsigned char *buf, int size, bool src)
+{
+	if (-a->delay > size)
+		a->delay += size;
+	else
+	{
+		if (src)
+			Wavefs44(a->file, size+a->delay, buf-a->delay);
+		else
+			fwrite(buf-a->delay, size+a->delay, 1, a->file);
+
+		a->size += size+a->delay;
+		a->delay = 0;
+	}
+}
+
+static void Do_Job(AUDIOJOB *job)
+{
+	unsigned char *data = (unsigned char *) job + JOB_HEADER;
+	int size;
+
+	switch (job->job)
+	{
+	case AUDIO_JOB_WRITE:
+		fwrite(data, job->length, 1, job->file);
+		break;
+
+	case AUDIO_JOB_AC3:
+		ac3_decode_data(data, job->length, 0);
+		break;
+
+	case AUDIO_JOB_AC3_WAV:
+		size = ac3_decode_data(data, job->length, 0);
+		WriteSamples(&audio[job->id], AC3Dec_Buffer, size, SRC_Flag != 0);
+		break;
+
+	case AUDIO_JOB_LPCM:
+		SwapLPCM(data, job->length, audio[job->id].format);
+		WriteSamples(&audio[job->id], data, job->length, false);
+		break;
+	}
+}
+
+static DWORD WINAPI Audio_Worker(LPVOID n)
+{
+	AUDIOJOB *job;
+	LONG tail = Tail;
+
+	while (true)
+	{
+		if (tail == Head)
+		{
+			InterlockedExchange(&WorkerWaiting, 1);
+			if (tail == Head)
+			{
+				if (Quit)
+					break;
+				WaitForSingleObject(hData, INFINITE);
+			}
+			InterlockedExchange(&WorkerWaiting, 0);
+			continue;
+		}
+		job = (AUDIOJOB *) (Ring + (tail & (AUDIO_RING_SIZE - 1)));
+		Do_Job(job);
+		tail += JOB_HEADER + ALIGN_JOB(job->length);
+		InterlockedExchange(&Tail, tail);
+		if (ParserWaiting)
+			SetEvent(hRoom);
+	}
+	return 0;
+}
+
+static void Wait_For_Room(LONG size)
+{
+	while (AUDIO_RING_SIZE - (Head - Tail) < size)
+	{
+		InterlockedExchange(&ParserWaiting, 1);
+		if (AUDIO_RING_SIZE - (Head - Tail) < size)
+			WaitForSingleObject(hRoom, INFINITE);
+		InterlockedExchange(&ParserWaiting, 0);
+	}
+}
+
+static void Publish(LONG size)
+{
+	InterlockedExchange(&Head, Head + size);
+	if (WorkerWaiting)
+		SetEvent(hData);
+}
+
+static void Start_Audio_Worker(void)
+{
+	DWORD id;
+
+	Ring = (unsigned char *) _aligned_malloc(AUDIO_RING_SIZE, AUDIO_JOB_ALIGN);
+	if (Ring == NULL)
+	{
+		MessageBox(hWnd, "Cannot allocate the audio buffer.\nAborting...", NULL, MB_OK | MB_ICONERROR);
+		ThreadKill(MISC_KILL);
+	}
+	Head = Tail = 0;
+	WorkerWaiting = ParserWaiting = Quit = 0;
+	hData = CreateEvent(NULL, FALSE, FALSE, NULL);
+	hRoom = CreateEvent(NULL, FALSE, FALSE, NULL);
+	hWorker = CreateThread(NULL, 0, Audio_Worker, 0, 0, &id);
+}
+
+// Returns where the length bytes of the job go. Audio_Queued() hands
+// the job to the worker once they have been copied.
+unsigned char *Queue_Audio(int job, int id, FILE *file, int length)
+{
+	AUDIOJOB *hdr;
+	LONG pos, left;
+
+	if (Ring == NULL)
+		Start_Audio_Worker();
+	if (length < 0)
+		length = 0;
+
+	// Jobs don't wrap, the end of the ring is skipped if the job doesn't fit.
+	pos = Head & (AUDIO_RING_SIZE - 1);
+	left = AUDIO_RING_SIZE - pos;
+	if (left < (LONG) (JOB_HEADER + ALIGN_JOB(length)))
+	{
+		Wait_For_Room(left);
+		hdr = (AUDIOJOB *) (Ring + pos);
+		hdr->job = AUDIO_JOB_SKIP;
+		hdr->length = left - JOB_HEADER;
+		Publish(left);
+		pos = 0;
+	}
+	Pending = JOB_HEADER + ALIGN_JOB(length);
+	Wait_For_Room(Pending);
+
+	hdr = (AUDIOJOB *) (Ring + pos);
+	hdr->job = job;
+	hdr->id = id;
+	hdr->file = file;
+	hdr->length = length;
+	return Ring + pos + JOB_HEADER;
+}
+
+void Audio_Queued(void)
+{
+	Publish(Pending);
+	Pending = 0;
+}
+
+// Waits for the worker to finish the queued jobs and ends it. Must be
+// called before the audio files are finished or closed.
+void Stop_Audio_Worker(void)
+{
+	if (Ring == NULL)
+		return;
+	InterlockedExchange(&Quit, 1);
+	SetEvent(hData);
+	WaitForSingleObject(hWorker, INFINITE);
+	CloseHandle(hWorker);
+	CloseHandle(hData);
+	CloseHandle(hRoom);
+	_aligned_free(Ring);
+	Ring = NULL;
+}
@@ -522,3 +522,136 @@ int fix_d2v(HWND hWnd, char *Input, int test_only)
 	return 0;
 }
 
+
+// Write the binary index of a D2V file, see D2VINDEXHEADER. Return 1 if it was written.
+int write_d2v_index(HWND hWnd, char *Input)
+{
+	FILE *fp, *wfp;
+	char line[2048], wfile[2048], *p;
+	int i, max_gops = 0, max_frames = 0, ok;
+	unsigned int val;
+	bool done = false;
+	D2VINDEXHEADER hdr;
+	D2VINDEXGOP *gops = NULL, *g;
+	unsigned char *flags = NULL;
+	WIN32_FILE_ATTRIBUTE_DATA attr;
+
+	sprintf(wfile, "%s.bin", Input);
+	// A stale index is ignored by DGDecode, but don't leave one behind.
+	_unlink(wfile);
+
+	fp = fopen(Input, "r");
+	if (fp == 0)
+	{
+		if (!CLIActive)
+			MessageBox(hWnd, "Cannot open the D2V file!", NULL, MB_OK | MB_ICONERROR);
+		return 0;
+	}
+	memset(&hdr, 0, sizeof(hdr));
+	memcpy(hdr.magic, D2V_INDEX_MAGIC, sizeof(hdr.magic));
+
+	// Skip the header up to the frame lines.
+	while (fgets(line, 2048, fp) != 0)
+		if (strncmp(line, "Location", 8) == 0) break;
+	fgets(line, 2048, fp);
+	ok = 1;
+	while (ok && !done && fgets(line, 2048, fp) != 0)
+	{
+		p = line;
+		if (sscanf(p, "%x", &val) != 1)
+			break;
+		if (val == 0xff)
+		{
+			done = true;
+			break;
+		}
+		if ((int) hdr.gops == max_gops)
+		{
+			max_gops += 10000;
+			gops = (D2VINDEXGOP *) realloc(gops, max_gops * sizeof(D2VINDEXGOP));
+			if (gops == NULL)
+			{
+				ok = 0;
+				break;
+			}
+		}
+		g = &gops[hdr.gops];
+		memset(g, 0, sizeof(D2VINDEXGOP));
+		if (sscanf(p, "%x %d %d %I64d %u %d %d", &g->info, &g->matrix, &g->file,
+				   &g->position, &g->I_count, &g->vob_id, &g->cell_id) != 7)
+		{
+			ok = 0;
+			break;
+		}
+		for (i = 0; i < 7; i++)
+		{
+			while (*p != ' ' && *p != 0) p++;
+			while (*p == ' ') p++;
+		}
+		g->first_frame = hdr.frames;
+		while (sscanf(p, "%x", &val) == 1)
+		{
+			if (val == 0xff)
+			{
+				done = true;
+				break;
+			}
+			if ((int) hdr.frames == max_frames)
+			{
+				max_frames += 100000;
+				flags = (unsigned char *) realloc(flags, max_frames);
+				if (flags == NULL)
+				{
+					ok = 0;
+					break;
+				}
+			}
+			flags[hdr.frames++] = (unsigned char) val;
+			while (*p != ' ' && *p != '\n' && *p != 0) p++;
+			while (*p == ' ') p++;
+		}
+		g->frames = hdr.frames - g->first_frame;
+		if (g->frames == 0)
+			ok = 0;
+		hdr.gops++;
+	}
+	fclose(fp);
+
+	// Only complete D2V files get an index.
+	if (!ok || !done || hdr.frames == 0 ||
+		!GetFileAttributesEx(Input, GetFileExInfoStandard, &attr))
+	{
+		free(gops);
+		free(flags);
+		if (!CLIActive)
+			MessageBox(hWnd, "Cannot read the frame lines of the D2V file,\nno binary index was written.", NULL, MB_OK | MB_ICONERROR);
+		return 0;
+	}
+	hdr.d2v_size = ((unsigned __int64) attr.nFileSizeHigh << 32) | attr.nFileSizeLow;
+	hdr.d2v_time = attr.ftLastWriteTime;
+
+	wfp = fopen(wfile, "wb");
+	if (wfp == 0)
+	{
+		free(gops);
+		free(flags);
+		if (!CLIActive)
+			MessageBox(hWnd, "Cannot create the binary index file!", NULL, MB_OK | MB_ICONERROR);
+		return 0;
+	}
+	ok = fwrite(&hdr, sizeof(hdr), 1, wfp) == 1 &&
+		 fwrite(gops, sizeof(D2VINDEXGOP), hdr.gops, wfp) == hdr.gops &&
+		 fwrite(flags, 1, hdr.frames, wfp) == hdr.frames;
+	if (fclose(wfp) != 0)
+		ok = 0;
+	free(gops);
+	free(flags);
+	if (!ok)
+	{
+		_unlink(wfile);
+		if (!CLIActive)
+			MessageBox(hWnd, "Cannot write the binary index file!", NULL, MB_OK | MB_ICONERROR);
+		return 0;
+	}
+	return 1;
+}
@@ -128,16 +128,16 @@ while (Rdptr >= (Rdbfr + BUFFER_SIZE))						\
 	Rdptr -= BUFFER_SIZE;									\
 }
 
-#define DECODE_AC3																\
+// Copies the rest of the packet for the audio worker, see audio_worker.cpp.
+#define QUEUE_AUDIO(job, id, fp)												\
 {																				\
-	if (SystemStream_Flag == TRANSPORT_STREAM && TransportPacketSize == 204)	\
-		Packet_Length -= 16;													\
-	size = 0;																	\
+	unsigned char *dst = Queue_Audio(job, id, fp, Packet_Length);				\
 	while (Packet_Length > 0)													\
 	{																			\
 		if (Packet_Length+Rdptr > BUFFER_SIZE+Rdbfr)							\
 		{																		\
-			size = ac3_decode_data(Rdptr, BUFFER_SIZE+Rdbfr-Rdptr, size);		\
+			memcpy(dst, Rdptr, BUFFER_SIZE+Rdbfr-Rdptr);						\
+			dst += BUFFER_SIZE+Rdbfr-Rdptr;										\
 			Packet_Length -= BUFFER_SIZE+Rdbfr-Rdptr;							\
 			Read = _donread(Infile[CurrentFile], Rdbfr, BUFFER_SIZE);			\
 			if (Read < BUFFER_SIZE) Next_File();								\
@@ -145,156 +145,50 @@ while (Rdptr >= (Rdbfr + BUFFER_SIZE))						\
 		}																		\
 		else																	\
 		{																		\
-			size = ac3_decode_data(Rdptr, Packet_Length, size);					\
+			memcpy(dst, Rdptr, Packet_Length);									\
 			Rdptr += Packet_Length;												\
 			Packet_Length = 0;													\
 		}																		\
 	}																			\
+	Audio_Queued();																\
 }
 
-#define DEMUX_AC3																\
-{																				\
+#define SKIP_DVB_TRAILER														\
 	if (SystemStream_Flag == TRANSPORT_STREAM && TransportPacketSize == 204)	\
-		Packet_Length -= 16;													\
-	while (Packet_Length > 0)													\
-	{																			\
-		if (Packet_Length+Rdptr > BUFFER_SIZE+Rdbfr)							\
-		{																		\
-			fwrite(Rdptr, BUFFER_SIZE+Rdbfr-Rdptr, 1, audio[AUDIO_ID].file);	\
-			Packet_Length -= BUFFER_SIZE+Rdbfr-Rdptr;							\
-			Read = _donread(Infile[CurrentFile], Rdbfr, BUFFER_SIZE);			\
-			if (Read < BUFFER_SIZE) Next_File();								\
-			Rdptr = Rdbfr;														\
-		}																		\
-		else																	\
-		{																		\
-			fwrite(Rdptr, Packet_Length, 1, audio[AUDIO_ID].file);				\
-			Rdptr += Packet_Length;												\
-			Packet_Length = 0;													\
-		}																		\
-	}																			\
+		Packet_Length -= 16;
+
+// Decoded for the normalization ratio only.
+#define DECODE_AC3																\
+{																				\
+	SKIP_DVB_TRAILER															\
+	QUEUE_AUDIO(AUDIO_JOB_AC3, AUDIO_ID, NULL)									\
 }
 
-void DemuxLPCM(int *size, int *Packet_Length, unsigned char PCM_Buffer[], unsigned char format)
-{
-	unsigned char tmp[12];
-	int i;
+#define DECODE_AC3_WAV															\
+{																				\
+	SKIP_DVB_TRAILER															\
+	QUEUE_AUDIO(AUDIO_JOB_AC3_WAV, AUDIO_ID, audio[AUDIO_ID].file)				\
+}
 
-	*size = 0;
-	while (*Packet_Length > 0)
-	{
-		if (*Packet_Length + Rdptr > BUFFER_SIZE + Rdbfr)
-		{
-			memcpy(PCM_Buffer + *size, Rdptr, BUFFER_SIZE + Rdbfr - Rdptr);
-			*size += (BUFFER_SIZE + Rdbfr - Rdptr);
-			*Packet_Length -= (BUFFER_SIZE + Rdbfr - Rdptr);
-			Read = _donread(Infile[CurrentFile], Rdbfr, BUFFER_SIZE);
-			if (Read < BUFFER_SIZE)
-				Next_File();
-			Rdptr = Rdbfr;
-		}
-		else
-		{
-			memcpy(PCM_Buffer + *size, Rdptr, *Packet_Length);
-			Rdptr += *Packet_Length;
-			*size += *Packet_Length;
-			*Packet_Length = 0;
-		}
-	}
-	if ((format & 0xc0) == 0)
-	{
-		// 16-bit LPCM.
-		for (i = 0; i < *size; i += 2)
-		{
-			tmp[0] = PCM_Buffer[i];
-			PCM_Buffer[i] = PCM_Buffer[i+1];
-			PCM_Buffer[i+1] = tmp[0];
-		}
-	}
-	else
-	{
-		// 24-bit LPCM.
-		if ((format & 0x07) + 1 == 1)
-		{
-			// Mono
-			for (i = 0; i < *size; i += 6)
-			{
-				tmp[0]=PCM_Buffer[i+4];
-				tmp[1]=PCM_Buffer[i+1];
-				tmp[2]=PCM_Buffer[i+0];
-				tmp[3]=PCM_Buffer[i+5];
-				tmp[4]=PCM_Buffer[i+3];
-				tmp[5]=PCM_Buffer[i+2];
-				memcpy(&PCM_Buffer[i], tmp, 6);
-			}
-		}
-		else
-		{
-			// Stereo
-			for (i = 0; i < *size; i += 12)
-			{
-				tmp[0] = PCM_Buffer[i+8];
-				tmp[1] = PCM_Buffer[i+1];
-				tmp[2] = PCM_Buffer[i+0];
-				tmp[3] = PCM_Buffer[i+9];
-				tmp[4] = PCM_Buffer[i+3];
-				tmp[5] = PCM_Buffer[i+2];
-				tmp[6] = PCM_Buffer[i+10];
-				tmp[7] = PCM_Buffer[i+5];
-				tmp[8] = PCM_Buffer[i+4];
-				tmp[9] = PCM_Buffer[i+11];
-				tmp[10] = PCM_Buffer[i+7];
-				tmp[11] = PCM_Buffer[i+6];
-				memcpy(&PCM_Buffer[i], tmp, 12);
-			}
-		}
-	}
+#define DEMUX_AC3																\
+{																				\
+	SKIP_DVB_TRAILER															\
+	QUEUE_AUDIO(AUDIO_JOB_WRITE, AUDIO_ID, audio[AUDIO_ID].file)				\
 }
 
+#define DEMUX_LPCM																\
+	QUEUE_AUDIO(AUDIO_JOB_LPCM, AUDIO_ID, audio[AUDIO_ID].file)
+
 #define DEMUX_MPA_AAC(fp)														\
 {																				\
-	if (SystemStream_Flag == TRANSPORT_STREAM && TransportPacketSize == 204)	\
-		Packet_Length -= 16;													\
-	while (Packet_Length > 0)													\
-	{																			\
-		if (Packet_Length+Rdptr > BUFFER_SIZE+Rdbfr)							\
-		{																		\
-			fwrite(Rdptr, BUFFER_SIZE+Rdbfr-Rdptr, 1, (fp));					\
-			Packet_Length -= BUFFER_SIZE+Rdbfr-Rdptr;							\
-			Read = _donread(Infile[CurrentFile], Rdbfr, BUFFER_SIZE);			\
-			if (Read < BUFFER_SIZE) Next_File();								\
-			Rdptr = Rdbfr;														\
-		}																		\
-		else																	\
-		{																		\
-			fwrite(Rdptr, Packet_Length, 1, (fp));								\
-			Rdptr += Packet_Length;												\
-			Packet_Length = 0;													\
-		}																		\
-	}																			\
+	SKIP_DVB_TRAILER															\
+	QUEUE_AUDIO(AUDIO_JOB_WRITE, 0, (fp))										\
 }
 
 #define DEMUX_DTS																\
 {																				\
-	if (SystemStream_Flag == TRANSPORT_STREAM && TransportPacketSize == 204)	\
-		Packet_Length -= 16;													\
-	while (Packet_Length > 0)													\
-	{																			\
-		if (Packet_Length+Rdptr > BUFFER_SIZE+Rdbfr)							\
-		{																		\
-			fwrite(Rdptr, BUFFER_SIZE+Rdbfr-Rdptr, 1, audio[AUDIO_ID].file);	\
-			Packet_Length -= BUFFER_SIZE+Rdbfr-Rdptr;							\
-			Read = _donread(Infile[CurrentFile], Rdbfr, BUFFER_SIZE);			\
-			if (Read < BUFFER_SIZE) Next_File();								\
-			Rdptr = Rdbfr;														\
-		}																		\
-		else																	\
-		{																		\
-			fwrite(Rdptr, Packet_Length, 1, audio[AUDIO_ID].file);				\
-			Rdptr += Packet_Length;												\
-			Packet_Length = 0;													\
-		}																		\
-	}																			\
+	SKIP_DVB_TRAILER															\
+	QUEUE_AUDIO(AUDIO_JOB_WRITE, AUDIO_ID, audio[AUDIO_ID].file)				\
 }
 
 static char *FTType[5] = {
@@ -339,8 +233,6 @@ static char *MPARate[4][15] = {
 };
 
 unsigned int VideoPTS, AudioPTS;
-static unsigned char PCM_Buffer[SECTOR_SIZE];
-static short *ptrPCM_Buffer = (short*)PCM_Buffer;
 
 unsigned char *buffer_invalid;
 
@@ -1150,20 +1042,7 @@ oops2:
 							audio[0].delay = 0;
 						}
 
-						DECODE_AC3
-
-						if (-audio[0].delay > size)
-							audio[0].delay += size;
-						else
-						{
-							if (SRC_Flag)
-								Wavefs44(audio[0].file, size+audio[0].delay, AC3Dec_Buffer-audio[0].delay);
-							else
-								fwrite(AC3Dec_Buffer-audio[0].delay, size+audio[0].delay, 1, audio[0].file);
-
-							audio[0].size += size+audio[0].delay;
-							audio[0].delay = 0;
-						}
+						DECODE_AC3_WAV
 
 						audio[0].rip = 1;
 					}
@@ -1257,20 +1136,7 @@ oops2:
 					DECODE_AC3
 				else if (Method_Flag==AUDIO_DECODE)
 				{
-					DECODE_AC3
-
-					if (-audio[0].delay > size)
-						audio[0].delay += size;
-					else
-					{
-						if (SRC_Flag)
-							Wavefs44(audio[0].file, size+audio[0].delay, AC3Dec_Buffer-audio[0].delay);
-						else
-							fwrite(AC3Dec_Buffer-audio[0].delay, size+audio[0].delay, 1, audio[0].file);
-
-						audio[0].size += size+audio[0].delay;
-						audio[0].delay = 0;
-					}
+					DECODE_AC3_WAV
 				}
 				else
 				{
@@ -1918,20 +1784,7 @@ oops:
 									audio[AUDIO_ID].delay = 0;
 								}
 
-								DECODE_AC3
-
-								if (-audio[AUDIO_ID].delay > size)
-									audio[AUDIO_ID].delay += size;
-								else
-								{
-									if (SRC_Flag)
-										Wavefs44(audio[AUDIO_ID].file, size+audio[AUDIO_ID].delay, AC3Dec_Buffer-audio[AUDIO_ID].delay);
-									else
-										fwrite(AC3Dec_Buffer-audio[AUDIO_ID].delay, size+audio[AUDIO_ID].delay, 1, audio[AUDIO_ID].file);
-
-									audio[AUDIO_ID].size += size+audio[AUDIO_ID].delay;
- 									audio[AUDIO_ID].delay = 0;
-								}
+								DECODE_AC3_WAV
 
 								audio[AUDIO_ID].rip = true;
 							}
@@ -1986,20 +1839,7 @@ oops:
 							DECODE_AC3
 						else if (Method_Flag==AUDIO_DECODE)
 						{
-							DECODE_AC3
-
-							if (-audio[AUDIO_ID].delay > size)
-								audio[AUDIO_ID].delay += size;
-							else
-							{
-								if (SRC_Flag)
-									Wavefs44(audio[AUDIO_ID].file, size+audio[AUDIO_ID].delay, AC3Dec_Buffer-audio[AUDIO_ID].delay);
-								else
-									fwrite(AC3Dec_Buffer-audio[AUDIO_ID].delay, size+audio[AUDIO_ID].delay, 1, audio[AUDIO_ID].file);
-
-								audio[AUDIO_ID].size += size+audio[AUDIO_ID].delay;
- 								audio[AUDIO_ID].delay = 0;
-							}
+							DECODE_AC3_WAV
 						}
 						else
 						{
@@ -2083,16 +1923,7 @@ oops:
 									audio[AUDIO_ID].delay = 0;
 								}
 
-								if (-audio[AUDIO_ID].delay > Packet_Length)
-									audio[AUDIO_ID].delay += Packet_Length;
-								else
-								{
-									DemuxLPCM(&size, &Packet_Length, PCM_Buffer, audio[AUDIO_ID].format);
-									fwrite(PCM_Buffer-audio[AUDIO_ID].delay, size+audio[AUDIO_ID].delay, 1, audio[AUDIO_ID].file);
-	
-									audio[AUDIO_ID].size += size+audio[AUDIO_ID].delay;
-									audio[AUDIO_ID].delay = 0;
-								}
+								DEMUX_LPCM
 
 								audio[AUDIO_ID].rip = true;
 							}
@@ -2100,16 +1931,7 @@ oops:
 					}
 					else if (audio[AUDIO_ID].rip)
 					{
-						if (-audio[AUDIO_ID].delay > Packet_Length)
-							audio[AUDIO_ID].delay += Packet_Length;
-						else
-						{
-							DemuxLPCM(&size, &Packet_Length, PCM_Buffer, audio[AUDIO_ID].format);
-							fwrite(PCM_Buffer-audio[AUDIO_ID].delay, size+audio[AUDIO_ID].delay, 1, audio[AUDIO_ID].file);
-
-							audio[AUDIO_ID].size += size+audio[AUDIO_ID].delay;
-							audio[AUDIO_ID].delay = 0;
-						}
+						DEMUX_LPCM
 					}
 				}
 				else if (AUDIO_ID>=SUB_DTS && AUDIO_ID<SUB_DTS+CHANNEL)
@@ -2604,6 +2426,85 @@ void Flush_Buffer_All(unsigned int N)
 	Fill_Next();
 }
 
+// next_start_code() for skipping slice data, which is most of the stream and
+// needs no parsing while indexing. Whole words of the bit reader are checked
+// at once and, when the rest of the packet (or of the buffer, for ES) is in
+// memory and no video is being demuxed, it is searched in place and the
+// reader restarted at the start code, so Fill_Next() and VideoDemux() don't
+// run for every 4 bytes.
+void Skip_To_Start_Code()
+{
+	unsigned __int64 w;
+	unsigned char *p, *end;
+	int k;
+
+	BitsLeft = ((BitsLeft + 7) / 8) * 8;
+	while (BitsLeft != 32)
+	{
+		if (Stop_Flag == true || Show_Bits(24) == 0x000001)
+			return;
+		Flush_Buffer(8);
+	}
+
+	for (;;)
+	{
+		if (Stop_Flag == true)
+			return;
+
+		// start codes beginning in CurrentBfr
+		w = ((unsigned __int64) CurrentBfr << 32) | NextBfr;
+		for (k = 0; k < 4; k++)
+		{
+			if (((w >> (40 - 8 * k)) & 0xffffff) == 0x000001)
+			{
+				Flush_Buffer(8 * k);
+				return;
+			}
+		}
+
+		if (SystemStream_Flag != ELEMENTARY_STREAM && !AudioOnly_Flag)
+			end = Rdmax;
+		else
+			end = Rdbfr + BUFFER_SIZE;
+		if (end > Rdbfr + BUFFER_SIZE)
+			end = Rdbfr + BUFFER_SIZE;
+		if (end > buffer_invalid)
+			end = buffer_invalid;
+		if (end - Rdptr < 16 || (MuxFile != NULL && MuxFile != (FILE *) 0xffffffff))
+		{
+			Flush_Buffer(32);
+			continue;
+		}
+
+		// NextBfr and what follows it in memory
+		w = ((unsigned __int64) NextBfr << 16) | (Rdptr[0] << 8) | Rdptr[1];
+		for (k = 0; k < 4; k++)
+		{
+			if (((w >> (24 - 8 * k)) & 0xffffff) == 0x000001)
+			{
+				Flush_Buffer(32 + 8 * k);
+				return;
+			}
+		}
+		for (p = Rdptr; p < end - 2; p++)
+		{
+			if (p[2] > 1)
+				p += 2;
+			else if (p[0] == 0 && p[1] == 0 && p[2] == 1)
+				break;
+		}
+		// Not found, the last two bytes might start one that continues
+		// in the next packet.
+		if (p > end - 2)
+			p = end - 2;
+
+		Rdptr = p;
+		Fill_Next();
+		CurrentBfr = NextBfr;
+		Fill_Next();
+	}
+}
+
 void Fill_Buffer()
 {
 	Read = _donread(Infile[CurrentFile], Rdbfr, BUFFER_SIZE);
@@ -31,6 +31,7 @@ void Fill_Buffer(void);
 void Next_Packet(void);
 void Flush_Buffer_All(unsigned int N);
 unsigned int Get_Bits_All(unsigned int N);
+void Skip_To_Start_Code(void);
 void Next_File(void);
 
 GXTN unsigned char *Rdbfr, *Rdptr, *Rdmax;
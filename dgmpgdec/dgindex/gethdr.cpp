@@ -148,7 +148,9 @@ int Get_Hdr(int mode)
 		// Look for next_start_code.
 		if (Stop_Flag == true)
 			return 1;
-		next_start_code();
+		// While indexing this steps over the slices of the last picture,
+		// when decoding picture_data() has already read them.
+		Skip_To_Start_Code();
 
 		code = Show_Bits(32);
 		switch (code)
@@ -336,6 +336,33 @@ XTN int HadAddDialog;
 XTN int hadRGoption;
 #define D2V_FILE_VERSION 16
 
+// The frame lines of a D2V file in binary, written next to it as *.d2v.bin
+// when BinaryIndex_Flag is set. DGDecode maps it instead of parsing the
+// lines; the size and write time of the D2V it was made from tell it when
+// the D2V was changed afterwards. The header is followed by one record per
+// GOP line and one byte of flags per frame.
+#define D2V_INDEX_MAGIC "DGIndexBinary16"
+
+typedef struct {
+	char				magic[16];
+	unsigned __int64	d2v_size;
+	FILETIME			d2v_time;
+	unsigned int		gops;
+	unsigned int		frames;
+} D2VINDEXHEADER;
+
+typedef struct {
+	__int64				position;
+	unsigned int		info;			// the first field of the line
+	int					matrix;
+	int					file;
+	unsigned int		I_count;
+	int					vob_id;
+	int					cell_id;
+	unsigned int		first_frame;
+	unsigned int		frames;
+} D2VINDEXGOP;
+
 XTN int WindowMode;
 XTN HWND hWnd, hDlg, hTrack;
 XTN HWND hwndSelect;
@@ -468,6 +495,10 @@ XTN int LogTimestamps_Flag;
 XTN int StartLogging_Flag;
 XTN FILE *Timestamps;
 XTN int InfoLog_Flag;
+XTN int BinaryIndex_Flag;
+// single precision SSE2 IMDCT in the AC3 decoder, off by default because
+// the WAV output then differs from the double code by 1 on a few samples
+XTN int FastAC3_Flag;
 
 /* gui */
 XTN void Recovery(void);
@@ -500,6 +531,15 @@ XTN void setRGBValues();
 XTN int mpeg_type;
 XTN int is_program_stream;
 
+/* audio_worker.c */
+#define AUDIO_JOB_WRITE		1	// demuxed as it is
+#define AUDIO_JOB_AC3		2	// decoded for Sound_Max only
+#define AUDIO_JOB_AC3_WAV	3	// decoded to the WAV of the track
+#define AUDIO_JOB_LPCM		4
+XTN unsigned char *Queue_Audio(int job, int id, FILE *file, int length);
+XTN void Audio_Queued(void);
+XTN void Stop_Audio_Worker(void);
+
 /* norm.c */
 XTN void Normalize(FILE *WaveIn, int WaveInPos, char *filename, FILE *WaveOut, int WaveOutPos, int size);
 
@@ -97,6 +97,7 @@ static char Outfilename[MAX_FILE_NUMBER][DG_MAX_PATH];
 
 extern int fix_d2v(HWND hWnd, char *path, int test_only);
 extern int parse_d2v(HWND hWnd, char *path);
+extern int write_d2v_index(HWND hWnd, char *path);
 extern int analyze_sync(HWND hWnd, char *path, int track);
 extern unsigned char *Rdbfr;
 
@@ -191,6 +192,8 @@ NEW_VERSION:
         BMPPathString[0] = 0;
         UseMPAExtensions = 0;
         NotifyWhenDone = 0;
+        BinaryIndex_Flag = 0;
+        FastAC3_Flag = 0;
     }
 	else
 	{
@@ -265,6 +268,8 @@ NEW_VERSION:
 		strcpy(BMPPathString, p);
         fscanf(INIFile, "Use_MPA_Extensions=%d\n", &UseMPAExtensions);
         fscanf(INIFile, "Notify_When_Done=%d\n", &NotifyWhenDone);
+        fscanf(INIFile, "Binary_Index=%d\n", &BinaryIndex_Flag);
+        fscanf(INIFile, "Fast_AC3=%d\n", &FastAC3_Flag);
 		fclose(INIFile);
 	}
 
@@ -550,8 +555,9 @@ TEST_END:
 	if (*lpCmdLine)
 	{
 		// CLI invocation.
-		if (parse_cli(lpCmdLine, ucCmdLine) != 0)
-			exit(0);
+		int cli = parse_cli(lpCmdLine, ucCmdLine);
+		if (cli != 0)
+			exit(cli > 0 ? 1 : 0);
 		if (NumLoadedFiles)
 		{
 			// Start a LOCATE_INIT thread. When it kills itself, it will start a
@@ -1196,6 +1202,9 @@ D2V_PROCESS:
 					if (PopFileDlg(szInput, hWnd, OPEN_D2V))
 					{
 						fix_d2v(hWnd, szInput, 0);
+						// The fixed D2V no longer matches its binary index.
+						if (BinaryIndex_Flag)
+							write_d2v_index(hWnd, szInput);
 					}
 					break;
 
@@ -1244,6 +1253,16 @@ D2V_PROCESS:
 					}
 					break;
 
+				case IDM_BINARY_INDEX:
+					BinaryIndex_Flag ^= 1;
+					CheckMenuItem(hMenu, IDM_BINARY_INDEX, BinaryIndex_Flag ? MF_CHECKED : MF_UNCHECKED);
+					break;
+
+				case IDM_FAST_AC3:
+					FastAC3_Flag ^= 1;
+					CheckMenuItem(hMenu, IDM_FAST_AC3, FastAC3_Flag ? MF_CHECKED : MF_UNCHECKED);
+					break;
+
 				case IDM_STOP:
 					Stop_Flag = true;
 					ExitOnEnd = 0;
@@ -2216,6 +2235,8 @@ right_arrow:
 				fprintf(INIFile, "BMP_Path=%s\n", BMPPathString);
 				fprintf(INIFile, "Use_MPA_Extensions=%d\n", UseMPAExtensions);
 				fprintf(INIFile, "Notify_When_Done=%d\n", NotifyWhenDone);
+				fprintf(INIFile, "Binary_Index=%d\n", BinaryIndex_Flag);
+				fprintf(INIFile, "Fast_AC3=%d\n", FastAC3_Flag);
 				fclose(INIFile);
 			}
 
@@ -2632,6 +2653,9 @@ void ThreadKill(int mode)
 	if (Quants)
 		fclose(Quants);
 
+	// The audio files are finished below.
+	Stop_Audio_Worker();
+
 	for (i = 0; i < 0xc8; i++)
 	{
 		if ((D2V_Flag || AudioOnly_Flag) &&
@@ -2695,6 +2719,9 @@ void ThreadKill(int mode)
                 // User wants to correct the field order transition.
                 fix_d2v(hWnd, D2VFilePath, 0);
             }
+			// After the fix, which rewrites the D2V.
+			if (BinaryIndex_Flag)
+				write_d2v_index(hWnd, D2VFilePath);
         }
 
 		if (Decision_Flag)
@@ -3747,6 +3774,12 @@ void CheckFlag()
 
     if (InfoLog_Flag)
         CheckMenuItem(hMenu, IDM_INFO_LOG, MF_CHECKED);
+
+    if (BinaryIndex_Flag)
+        CheckMenuItem(hMenu, IDM_BINARY_INDEX, MF_CHECKED);
+
+    if (FastAC3_Flag)
+        CheckMenuItem(hMenu, IDM_FAST_AC3, MF_CHECKED);
 }
 
 void Recovery()
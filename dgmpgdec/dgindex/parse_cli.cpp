@@ -3,6 +3,162 @@
 #include "Shlwapi.h"
 #include "global.h"
 
+// Writes msg to stderr. DGIndex has no console of its own, so this only
+// shows up where stderr has been redirected.
+static void print_error(const char *msg)
+{
+	DWORD written;
+
+	WriteFile(GetStdHandle(STD_ERROR_HANDLE), msg, strlen(msg), &written, NULL);
+}
+
+// Reports an error in the command line. A hidden instance that exits by
+// itself, as the batch jobs do, has nobody to close a message box, so it
+// gets the error on stderr instead.
+static void cli_error(LPSTR ucCmdLine, const char *msg)
+{
+	if (WindowMode == SW_HIDE && strstr(ucCmdLine, "-EXIT"))
+	{
+		print_error(msg);
+		print_error("\n");
+	}
+	else
+		MessageBox(hWnd, msg, NULL, MB_OK | MB_ICONERROR);
+}
+
+// Reports a line of the batch list that failed, on stderr and in list.log,
+// which is only created when something fails.
+static void batch_failed(const char *list, FILE **log, int lineno, const char *line, const char *why)
+{
+	char msg[DG_MAX_PATH + 4096 + 64], name[DG_MAX_PATH + 8];
+
+	sprintf(msg, "%s(%d): %s: %s\n", list, lineno, why, line);
+	print_error(msg);
+	if (*log == NULL)
+	{
+		sprintf(name, "%s.log", list);
+		*log = fopen(name, "w");
+	}
+	if (*log != NULL)
+		fputs(msg, *log);
+}
+
+// Closes the process of a finished job. Returns 1 if the job failed.
+static int finish_job(HANDLE process, const char *list, FILE **log, int lineno, const char *line)
+{
+	char why[64];
+	DWORD code;
+	int failed = 1;
+
+	if (!GetExitCodeProcess(process, &code))
+		strcpy(why, "couldn't get the exit code");
+	else if (code == STILL_ACTIVE)
+		strcpy(why, "still running");
+	else if (code != 0)
+		sprintf(why, "exit code %lu", code);
+	else
+		failed = 0;
+	if (failed)
+		batch_failed(list, log, lineno, line, why);
+	CloseHandle(process);
+	return failed;
+}
+
+// Runs the command lines in the list file, one per line, each in a hidden
+// DGIndex process of its own, so the jobs share none of the parser state.
+// At most jobs of them run at a time, by default one per processor.
+// Returns the number of lines that failed to run or exited with an error.
+static int run_batch(char *list, int jobs)
+{
+	static char lines[MAXIMUM_WAIT_OBJECTS][4096];
+	char exe[DG_MAX_PATH], line[4096], cmd[DG_MAX_PATH + 4096 + 32];
+	HANDLE running[MAXIMUM_WAIT_OBJECTS];
+	int lineno[MAXIMUM_WAIT_OBJECTS];
+	STARTUPINFO si;
+	PROCESS_INFORMATION pi;
+	SYSTEM_INFO sysinfo;
+	FILE *fp, *log = NULL;
+	char *p;
+	int n = 0, num = 0, failed = 0;
+	DWORD i;
+
+	fp = fopen(list, "r");
+	if (fp == NULL)
+	{
+		print_error("Couldn't open batch list file! Exiting.\n");
+		return 1;
+	}
+	GetModuleFileName(NULL, exe, sizeof(exe));
+	if (jobs <= 0)
+	{
+		GetSystemInfo(&sysinfo);
+		jobs = sysinfo.dwNumberOfProcessors;
+	}
+	if (jobs > MAXIMUM_WAIT_OBJECTS)
+		jobs = MAXIMUM_WAIT_OBJECTS;
+
+	while (fgets(line, sizeof(line), fp) != NULL)
+	{
+		num++;
+		p = line + strlen(line);
+		while (p > line && (p[-1] == '\n' || p[-1] == '\r' || p[-1] == ' ' || p[-1] == '\t'))
+			*--p = 0;
+		p = line;
+		while (*p == ' ' || *p == '\t') p++;
+		if (*p == 0)
+			continue;
+
+		if (n == jobs)
+		{
+			// Wait for one to finish. If waiting fails, start no more of them.
+			i = WaitForMultipleObjects(n, running, FALSE, INFINITE) - WAIT_OBJECT_0;
+			if (i >= (DWORD)n)
+			{
+				batch_failed(list, &log, num, p, "couldn't wait for the running jobs");
+				failed++;
+				break;
+			}
+			failed += finish_job(running[i], list, &log, lineno[i], lines[i]);
+			n--;
+			running[i] = running[n];
+			lineno[i] = lineno[n];
+			strcpy(lines[i], lines[n]);
+		}
+		sprintf(cmd, "\"%s\" %s -hide -exit", exe, p);
+		memset(&si, 0, sizeof(si));
+		si.cb = sizeof(si);
+		if (CreateProcess(NULL, cmd, NULL, NULL, FALSE, 0, NULL, NULL, &si, &pi))
+		{
+			CloseHandle(pi.hThread);
+			running[n] = pi.hProcess;
+			lineno[n] = num;
+			strcpy(lines[n], p);
+			n++;
+		}
+		else
+		{
+			batch_failed(list, &log, num, p, "couldn't start DGIndex");
+			failed++;
+		}
+	}
+	fclose(fp);
+
+	// The jobs that are left are reported as still running if this fails.
+	if (n)
+		WaitForMultipleObjects(n, running, TRUE, INFINITE);
+	while (n)
+	{
+		n--;
+		failed += finish_job(running[n], list, &log, lineno[n], lines[n]);
+	}
+	if (log != NULL)
+		fclose(log);
+	return failed;
+}
+
+// Returns 0 to go on with the GUI, -1 to exit when the command line has
+// been carried out and 1 to exit after an error.
+
 int parse_cli(LPSTR lpCmdLine, LPSTR ucCmdLine)
 {
 	char cwd[DG_MAX_PATH];
@@ -19,12 +175,15 @@ int parse_cli(LPSTR lpCmdLine, LPSTR ucCmdLine)
 		char opt[32], *o;
 		char suffix[DG_MAX_PATH];
 		int val;
+		char batch_list[DG_MAX_PATH];
+		int batch_jobs = 0;
 
 		// CLI invocation.
 		NumLoadedFiles = 0;
 		CLIPreview = 0;
 		ExitOnEnd = 0;
 		hadRGoption = 0;
+		batch_list[0] = 0;
 
 		while (1)
 		{
@@ -521,6 +680,63 @@ another:
 				{
 					ExitOnEnd = 1;
 				}
+				else if (!strncmp(opt, "bin", 3))
+				{
+					BinaryIndex_Flag = 1;
+					CheckMenuItem(hMenu, IDM_BINARY_INDEX, MF_CHECKED);
+				}
+				else if (!strncmp(opt, "fast", 4))
+				{
+					FastAC3_Flag = 1;
+					CheckMenuItem(hMenu, IDM_FAST_AC3, MF_CHECKED);
+				}
+				else if (!strncmp(opt, "batch", 5))
+				{
+					while (*p == ' ' || *p == '\t') p++;
+					f = name;
+					while (1)
+					{
+						if ((in_quote == 0) && (*p == ' ' || *p == '\t' || *p == 0))
+							break;
+						if ((in_quote == 1) && (*p == 0))
+							break;
+						if (*p == '"')
+						{
+							if (in_quote == 0)
+							{
+								in_quote = 1;
+								p++;
+							}
+							else
+							{
+								in_quote = 0;
+								p++;
+								break;
+							}
+						}
+						*f++ = *p++;
+					}
+					*f = 0;
+					/* If the specified file does not include a path, use the
+					   current directory. */
+					if (name[0] != '\\' && name[1] != ':')
+					{
+						GetCurrentDirectory(sizeof(batch_list) - 1, batch_list);
+						strcat(batch_list, "\\");
+						strcat(batch_list, name);
+					}
+					else
+					{
+						strcpy(batch_list, name);
+					}
+				}
+				else if (!strncmp(opt, "jobs", 4))
+				{
+					while (*p == ' ' || *p == '\t') p++;
+					sscanf(p, "%d", &batch_jobs);
+					while (*p != '-' && *p != 0) p++;
+					p--;
+				}
 				else if (!strncmp(opt, "o", 3) || !strncmp(opt, "od", 3))
 				{
 					// Set up demuxing if requested.
@@ -576,15 +792,21 @@ another:
 			else
 				break;
 		}
+		if (batch_list[0])
+		{
+			// The jobs do all the work, this instance only waits for them.
+			ShowWindow(hWnd, SW_HIDE);
+			return run_batch(batch_list, batch_jobs) ? 1 : -1;
+		}
 		if (NumLoadedFiles == 0 && WindowMode == SW_HIDE)
 		{
-			MessageBox(hWnd, "Couldn't open input file in HIDE mode! Exiting.", NULL, MB_OK | MB_ICONERROR);
-			return -1;
+			cli_error(ucCmdLine, "Couldn't open input file in HIDE mode! Exiting.");
+			return 1;
 		}
 		if (!CLIActive && WindowMode == SW_HIDE)
 		{
-			MessageBox(hWnd, "No output file in HIDE mode! Exiting.", NULL, MB_OK | MB_ICONERROR);
-			return -1;
+			cli_error(ucCmdLine, "No output file in HIDE mode! Exiting.");
+			return 1;
 		}
 		CheckFlag();
 	}
@@ -792,8 +1014,8 @@ another:
 
 		if (NumLoadedFiles == 0 && WindowMode == SW_HIDE)
 		{
-			MessageBox(hWnd, "Couldn't open input file in HIDE mode! Exiting.", NULL, MB_OK | MB_ICONERROR);
-			return -1;
+			cli_error(ucCmdLine, "Couldn't open input file in HIDE mode! Exiting.");
+			return 1;
 		}
 
 		// Transport PIDs
@@ -1162,8 +1384,8 @@ another:
 
 		if (!CLIActive && WindowMode == SW_HIDE)
 		{
-			MessageBox(hWnd, "No output file in HIDE mode! Exiting.", NULL, MB_OK | MB_ICONERROR);
-			return -1;
+			cli_error(ucCmdLine, "No output file in HIDE mode! Exiting.");
+			return 1;
 		}
 	}
 	return 0;
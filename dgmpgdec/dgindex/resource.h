@@ -219,6 +219,8 @@
 #define IDM_CLOSE                       32883
 #define IDM_COPYFRAMETOCLIPBOARD        32884
 #define IDM_FULL_SIZED                  32885
+#define IDM_BINARY_INDEX                32886
+#define IDM_FAST_AC3                    32887
 #define ID_MRU_FILE0                    50000
 #define ID_MRU_FILE1                    50001
 #define ID_MRU_FILE2                    50002
@@ -231,7 +233,7 @@
 #ifndef APSTUDIO_READONLY_SYMBOLS
 #define _APS_NO_MFC                     1
 #define _APS_NEXT_RESOURCE_VALUE        26
-#define _APS_NEXT_COMMAND_VALUE         32886
+#define _APS_NEXT_COMMAND_VALUE         32888
 #define _APS_NEXT_CONTROL_VALUE         1098
 #define _APS_NEXT_SYMED_VALUE           101
 #endif
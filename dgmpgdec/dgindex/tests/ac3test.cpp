@@ -0,0 +1,231 @@
+/* ac3test.cpp, checks and times the SSE2 AC3 decoding                       */
+
+/*
+ *  Every AC3 file given is decoded to 16-bit stereo three times, the way
+ *  DGIndex decodes to WAV: with the C code only, with the default SSE2
+ *  code, which has to give the same samples, and with the single precision
+ *  IMDCT of Fast_AC3=1, which may be 1 off. The samples that differ are
+ *  counted and each decode is timed, best of several runs. Then the four
+ *  IMDCT functions are timed on their own, on random coefficients.
+ *
+ *  Usage: ac3test [-n runs, default 3] [file.ac3 ...]
+ *  Exits with 1 if the default decode differs from C or the fast one is
+ *  more than 1 off.
+ *
+ *  This file is part of DGIndex.
+ *
+ *  DGIndex is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  DGIndex is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with GNU Make; see the file COPYING.  If not, write to
+ *  the Free Software Foundation, 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+#define GLOBAL
+#include "global.h"
+#include "AC3Dec/ac3.h"
+
+void imdct_do_256(double data[], double delay[]);
+void imdct_do_512(double data[], double delay[]);
+void imdct_do_256_sse2(double data[], float delay[]);
+void imdct_do_512_sse2(double data[], float delay[]);
+
+// small enough that AC3Dec_Buffer holds the frames of one call
+#define CHUNK		1024
+#define BLOCKS		20000
+
+void ThreadKill(int)
+{
+	fprintf(stderr, "decoder gave up\n");
+	exit(2);
+}
+
+struct Decode {
+	short *pcm;
+	long samples, size;
+	double ms;
+};
+
+static double now_ms(void)
+{
+	static LARGE_INTEGER freq;
+	LARGE_INTEGER t;
+
+	if (!freq.QuadPart)
+		QueryPerformanceFrequency(&freq);
+	QueryPerformanceCounter(&t);
+	return 1000.0 * t.QuadPart / freq.QuadPart;
+}
+
+static void decode(unsigned char *data, long len, bool sse2, int fast, int runs, Decode *d)
+{
+	cpu.sse2 = sse2;
+	FastAC3_Flag = fast;
+	d->ms = 0;
+
+	for (int r = 0; r < runs; r++)
+	{
+		double t = now_ms();
+
+		InitialAC3();
+		d->samples = 0;
+		for (long pos = 0; pos < len; pos += CHUNK)
+		{
+			long chunk = len - pos < CHUNK ? len - pos : CHUNK;
+			uint_32 bytes = ac3_decode_data(data + pos, chunk, 0);
+			long n = bytes / sizeof(short);
+
+			if (d->samples + n > d->size)
+			{
+				d->size = 2 * (d->samples + n);
+				d->pcm = (short *)realloc(d->pcm, d->size * sizeof(short));
+			}
+			memcpy(d->pcm + d->samples, AC3Dec_Buffer, bytes);
+			d->samples += n;
+		}
+		t = now_ms() - t;
+		if (!r || t < d->ms)
+			d->ms = t;
+	}
+}
+
+// returns the largest difference, or -1 if the lengths differ
+static int compare(const Decode *a, const Decode *b, long *diffs)
+{
+	int peak = 0;
+
+	*diffs = 0;
+	if (a->samples != b->samples)
+		return -1;
+	for (long i = 0; i < a->samples; i++)
+	{
+		int e = abs(a->pcm[i] - b->pcm[i]);
+		if (e)
+		{
+			(*diffs)++;
+			if (e > peak)
+				peak = e;
+		}
+	}
+	return peak;
+}
+
+static bool test_file(const char *name, int runs)
+{
+	static Decode c, exact, fast;
+	FILE *fp = fopen(name, "rb");
+	unsigned char *data;
+	long len, diffs;
+	int peak;
+	bool ok = true;
+
+	if (!fp)
+	{
+		printf("%s: cannot open  FAILED\n", name);
+		return false;
+	}
+	fseek(fp, 0, SEEK_END);
+	len = ftell(fp);
+	fseek(fp, 0, SEEK_SET);
+	data = (unsigned char *)malloc(len + 1);
+	len = (long)fread(data, 1, len, fp);
+	fclose(fp);
+
+	decode(data, len, false, 0, runs, &c);
+	decode(data, len, true, 0, runs, &exact);
+	decode(data, len, true, 1, runs, &fast);
+	free(data);
+
+	printf("%s: %ld stereo samples\n", name, c.samples / 2);
+	if (!c.samples)
+	{
+		printf("  no AC3 frames  FAILED\n");
+		return false;
+	}
+	printf("  C      %8.1f ms\n", c.ms);
+
+	peak = compare(&c, &exact, &diffs);
+	printf("  SSE2   %8.1f ms, %ld samples differ from C  %s\n",
+		   exact.ms, diffs, peak ? "FAILED" : "ok");
+	ok &= !peak;
+
+	peak = compare(&c, &fast, &diffs);
+	printf("  fast   %8.1f ms, %ld samples (%.3f%%) differ from C, by up to %d  %s\n",
+		   fast.ms, diffs, 100.0 * diffs / c.samples, peak,
+		   peak < 0 || peak > 1 ? "FAILED" : "ok");
+	ok &= peak >= 0 && peak <= 1;
+	return ok;
+}
+
+template <class T>
+static double time_imdct(void (*imdct_do)(double[], T[]), T *delay, double (*coef)[256])
+{
+	__declspec(align(16)) static double data[256];
+	double t = now_ms();
+
+	for (int i = 0; i < BLOCKS; i++)
+	{
+		memcpy(data, coef[i & 15], sizeof(data));
+		imdct_do(data, delay);
+	}
+	return 1000.0 * (now_ms() - t) / BLOCKS;
+}
+
+// per-block times of the transforms alone, the copy of the input included
+static void bench_imdct(void)
+{
+	__declspec(align(16)) static double coef[16][256];
+	__declspec(align(16)) static double delay[256];
+	__declspec(align(16)) static float fdelay[256];
+
+	for (int b = 0; b < 16; b++)
+		for (int i = 0; i < 256; i++)
+			coef[b][i] = (rand() - RAND_MAX / 2) / (double)RAND_MAX;
+	InitialAC3();
+
+	printf("IMDCT, us per channel block:\n");
+	printf("  512    C %.3f, SSE2 %.3f\n",
+		   time_imdct(imdct_do_512, delay, coef), time_imdct(imdct_do_512_sse2, fdelay, coef));
+	printf("  256    C %.3f, SSE2 %.3f\n",
+		   time_imdct(imdct_do_256, delay, coef), time_imdct(imdct_do_256_sse2, fdelay, coef));
+}
+
+int main(int argc, char **argv)
+{
+	int runs = 3, i = 1;
+	bool ok = true;
+
+	if (argc > 2 && !strcmp(argv[1], "-n"))
+	{
+		runs = atoi(argv[2]);
+		i = 3;
+	}
+	if (runs < 1)
+	{
+		fprintf(stderr, "usage: ac3test [-n runs] [file.ac3 ...]\n");
+		return 2;
+	}
+	if (!IsProcessorFeaturePresent(PF_XMMI64_INSTRUCTIONS_AVAILABLE))
+	{
+		fprintf(stderr, "ac3test needs SSE2\n");
+		return 2;
+	}
+
+	// as DGIndex decodes to WAV with no gain, DRC or downmix options
+	PreScale_Ratio = 1.0;
+	DRC_Flag = DRC_NONE;
+
+	for (; i < argc; i++)
+		ok &= test_file(argv[i], runs);
+	bench_imdct();
+	return ok ? 0 : 1;
+}